@@ -0,0 +1,460 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Microbenchmarks of the DLARP hot paths: routing table insertion, lookup
+ * and expiry, RouteOutput, RouteInput and the reception of DLARP messages.
+ * The protocol runs on a single node with one SimpleNetDevice, and its
+ * routing table is filled with synthetic routes: no wireless simulation is
+ * involved.  A second node on the same SimpleChannel sends it the messages
+ * of the parse-* benchmarks, which time RecvDlarp together with the
+ * UDP/IPv4 stack below it; recv-udp times the stack alone, with datagrams
+ * delivered to a plain UDP socket.
+ *
+ * Every result is one CSV line:
+ *
+ *   benchmark,destinations,ops,ns_per_op,allocs_per_op,peak_rss_kb
+ *
+ * allocs_per_op counts the calls to operator new made during the timed
+ * loop, and peak_rss_kb is the peak resident set size of the process when
+ * the benchmark ends.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/dlarp-helper.h"
+#include "ns3/dlarp.h"
+#include "ns3/dlarp-rtable.h"
+#include "ns3/dlarp-packet.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DlarpBench");
+
+/// Number of calls to operator new since the start of the program
+static uint64_t g_allocations = 0;
+
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+namespace {
+
+/// Output stream of the results
+std::ostream *g_out = &std::cout;
+
+/// Timing and allocation count of one timed loop
+class BenchTimer
+{
+public:
+  BenchTimer () :
+    m_allocations (g_allocations),
+    m_start (std::chrono::steady_clock::now ())
+  {
+  }
+  /**
+   * \brief Print the result line of the loop
+   * \param name the benchmark
+   * \param destinations the routing table size
+   * \param ops the number of operations done by the loop
+   */
+  void Report (const std::string &name, uint32_t destinations, uint64_t ops) const
+  {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+    uint64_t allocations = g_allocations - m_allocations;
+    double ns = std::chrono::duration<double, std::nano> (end - m_start).count ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    *g_out << name << "," << destinations << "," << ops << ","
+           << ns / ops << "," << double (allocations) / ops << ","
+           << usage.ru_maxrss << std::endl;
+  }
+
+private:
+  uint64_t m_allocations;                               //!< Allocations before the loop
+  std::chrono::steady_clock::time_point m_start;        //!< Start of the loop
+};
+
+/// Callbacks of RouteInput; they only count the packets
+uint64_t g_forwarded = 0;
+
+void
+CountForward (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header &header)
+{
+  g_forwarded++;
+}
+
+void
+CountError (Ptr<const Packet> p, const Ipv4Header &header, Socket::SocketErrno err)
+{
+}
+
+/**
+ * \param i index of a synthetic destination
+ * \return its address, in 10.128.0.0/9
+ */
+Ipv4Address
+Destination (uint32_t i)
+{
+  return Ipv4Address (0x0a800000 + i);
+}
+
+/**
+ * \brief Fill a routing table with destinations, three candidates each
+ * \param table the table
+ * \param destinations the number of destinations
+ * \param lifetime the lifetime of the routes
+ */
+void
+FillTable (DlarpRoutingTable &table, uint32_t destinations, Time lifetime)
+{
+  for (uint32_t i = 0; i < destinations; ++i)
+    {
+      for (uint32_t c = 0; c < 3; ++c)
+        {
+          DlarpRoutingTableEntry entry (Destination (i), Ipv4Address (0x0a000002 + c), 1, i);
+          entry.SetMetric (1 + c + i % 7);
+          entry.SetLifeTime (Simulator::Now () + lifetime);
+          table.AddRoute (entry);
+        }
+    }
+}
+
+/**
+ * \brief Benchmark routing table insertion and lookup
+ * \param destinations the number of destinations
+ * \param ops the number of lookups
+ */
+void
+BenchTable (uint32_t destinations, uint64_t ops)
+{
+  {
+    uint64_t rounds = std::max<uint64_t> (1, ops / (3 * destinations));
+    BenchTimer timer;
+    for (uint64_t r = 0; r < rounds; ++r)
+      {
+        DlarpRoutingTable table;
+        FillTable (table, destinations, Seconds (100));
+      }
+    timer.Report ("rtable-insert", destinations, rounds * 3 * destinations);
+  }
+
+  DlarpRoutingTable table;
+  FillTable (table, destinations, Seconds (100));
+  uint64_t found = 0;
+  BenchTimer timer;
+  for (uint64_t i = 0; i < ops; ++i)
+    {
+      found += (table.LookupRoute (Destination ((i * 2654435761u) % destinations)) != 0);
+    }
+  timer.Report ("rtable-lookup", destinations, ops);
+  NS_ABORT_IF (found != ops);
+}
+
+/**
+ * \brief Benchmark route expiry, as done by the expiry timer wheel: one
+ * purge per destination once every route has expired
+ * \param destinations the number of destinations
+ */
+void
+BenchExpire (uint32_t destinations)
+{
+  DlarpRoutingTable table;
+  FillTable (table, destinations, Seconds (1));
+  // Run the purge once the routes have expired
+  Simulator::Schedule (Seconds (2), [&table, destinations] ()
+    {
+      Time next;
+      BenchTimer timer;
+      for (uint32_t i = 0; i < destinations; ++i)
+        {
+          table.Purge (Destination (i), next);
+        }
+      timer.Report ("rtable-expire", destinations, destinations);
+      NS_ABORT_IF (table.GetNDestinations () != 0);
+    });
+  Simulator::Stop (Seconds (3));
+  Simulator::Run ();
+}
+
+/**
+ * \brief Benchmark RouteOutput and RouteInput of a protocol whose table
+ * holds destinations
+ * \param routing the protocol
+ * \param device its device
+ * \param destinations the number of destinations
+ * \param ops the number of calls
+ */
+void
+BenchRoute (Ptr<DlarpRoutingProtocol> routing, Ptr<NetDevice> device, uint32_t destinations, uint64_t ops)
+{
+  routing->GetRoutingTable ().Clear ();
+  FillTable (routing->GetRoutingTable (), destinations, Seconds (1000));
+
+  Ptr<Packet> packet = Create<Packet> (64);
+  Ipv4Header header;
+  header.SetSource (Ipv4Address ("10.0.0.1"));
+  header.SetProtocol (17);
+
+  {
+    Socket::SocketErrno sockerr;
+    uint64_t routed = 0;
+    BenchTimer timer;
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        header.SetDestination (Destination ((i * 2654435761u) % destinations));
+        routed += (routing->RouteOutput (packet, header, 0, sockerr) != 0);
+      }
+    timer.Report ("route-output", destinations, ops);
+    NS_ABORT_IF (routed != ops);
+  }
+
+  Ipv4RoutingProtocol::UnicastForwardCallback ucb = MakeCallback (&CountForward);
+  Ipv4RoutingProtocol::MulticastForwardCallback mcb;
+  Ipv4RoutingProtocol::LocalDeliverCallback lcb;
+  Ipv4RoutingProtocol::ErrorCallback ecb = MakeCallback (&CountError);
+  g_forwarded = 0;
+  header.SetSource (Ipv4Address ("10.0.0.3"));
+  BenchTimer timer;
+  for (uint64_t i = 0; i < ops; ++i)
+    {
+      header.SetDestination (Destination ((i * 2654435761u) % destinations));
+      routing->RouteInput (packet, header, device, ucb, mcb, lcb, ecb);
+    }
+  timer.Report ("route-input", destinations, ops);
+  NS_ABORT_IF (g_forwarded != ops);
+}
+
+/// Datagrams received by the UDP sink of the delivery baseline
+uint64_t g_sunk = 0;
+
+/// Receive callback of the UDP sink; it only counts the datagrams
+void
+CountSunk (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      g_sunk++;
+    }
+}
+
+/**
+ * \brief Send copies of a datagram, one batch per microsecond; a batch is
+ * small enough for the queue of the sending device
+ * \param socket the socket of the sending node
+ * \param packet the datagram
+ * \param to where it goes
+ * \param count the number of copies left to send
+ */
+void
+SendBatch (Ptr<Socket> socket, Ptr<Packet> packet, InetSocketAddress to, uint64_t count)
+{
+  uint64_t batch = std::min<uint64_t> (count, 64);
+  for (uint64_t i = 0; i < batch; ++i)
+    {
+      socket->SendTo (packet->Copy (), 0, to);
+    }
+  if (count > batch)
+    {
+      Simulator::Schedule (MicroSeconds (1), &SendBatch, socket, packet, to, count - batch);
+    }
+}
+
+/**
+ * \brief Time the delivery of copies of a datagram from the sending node
+ * \param name the benchmark
+ * \param sender the socket of the sending node
+ * \param packet the datagram
+ * \param to where it goes
+ * \param ops the number of copies
+ */
+void
+BenchDelivery (const std::string &name, Ptr<Socket> sender, Ptr<Packet> packet, InetSocketAddress to, uint64_t ops)
+{
+  Simulator::ScheduleNow (&SendBatch, sender, packet, to, ops);
+  Simulator::Stop (MicroSeconds ((ops + 63) / 64 + 1));
+  BenchTimer timer;
+  Simulator::Run ();
+  timer.Report (name, 0, ops);
+}
+
+/**
+ * \brief Benchmark the reception of one DLARP message type: the datagrams
+ * go up the UDP/IPv4 stack of the DLARP node to RecvDlarp, which parses
+ * and processes them
+ * \param name the benchmark
+ * \param header the message
+ * \param routing the protocol of the receiving node
+ * \param sender the socket of the sending node
+ * \param ops the number of messages received
+ */
+void
+BenchParse (const std::string &name, const DlarpHeader &header, Ptr<DlarpRoutingProtocol> routing,
+            Ptr<Socket> sender, uint64_t ops)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  InetSocketAddress to (routing->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal (), DlarpRoutingProtocol::DLARP_PORT);
+  DlarpStats before = routing->GetStats ();
+  BenchDelivery (name, sender, packet, to, ops);
+  DlarpStats after = routing->GetStats ();
+  NS_ABORT_IF (after.rxDatagrams - before.rxDatagrams != ops);
+  NS_ABORT_IF (after.rxInvalid != before.rxInvalid);
+}
+
+/**
+ * \brief Benchmark the reception of every DLARP message type, and the
+ * delivery of a plain UDP datagram as the share of the stack in it
+ * \param routing the protocol of the receiving node
+ * \param sender the socket of the sending node
+ * \param ops the number of messages received per type
+ */
+void
+BenchParsing (Ptr<DlarpRoutingProtocol> routing, Ptr<Socket> sender, uint64_t ops)
+{
+  Ptr<Node> node = routing->GetObject<Node> ();
+  Ptr<Socket> sink = Socket::CreateSocket (node, UdpSocketFactory::GetTypeId ());
+  sink->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  sink->SetRecvCallback (MakeCallback (&CountSunk));
+  InetSocketAddress to (node->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal (), 9);
+
+  // Resolve the address of the DLARP node before timing anything
+  Simulator::ScheduleNow (&SendBatch, sender, Create<Packet> (64), to, 1);
+  Simulator::Stop (MicroSeconds (1));
+  Simulator::Run ();
+  g_sunk = 0;
+  BenchDelivery ("recv-udp", sender, Create<Packet> (64), to, ops);
+  NS_ABORT_IF (g_sunk != ops);
+  sink->Close ();
+
+  DlarpHeader hello (DLARPTYPE_HELLO);
+  hello.SetSeqNo (1);
+  for (uint32_t i = 0; i < 16; ++i)
+    {
+      DlarpHelloRecord record;
+      record.neighbor = Destination (i);
+      record.ratio = 0.9;
+      hello.AddHelloRecord (record);
+    }
+  BenchParse ("parse-hello", hello, routing, sender, ops);
+
+  // Past the first one, the copies of a request are duplicates, as most
+  // of the requests a node hears are
+  DlarpHeader rreq (DLARPTYPE_RREQ);
+  rreq.SetSrc (Ipv4Address ("10.0.0.5"));
+  rreq.SetDst (Ipv4Address ("10.0.0.9"));
+  rreq.SetRequestId (7);
+  rreq.SetMetric (3.5);
+  BenchParse ("parse-rreq", rreq, routing, sender, ops);
+
+  // Replies to a request of the DLARP node itself
+  DlarpHeader rrep (DLARPTYPE_RREP);
+  rrep.SetSrc (Ipv4Address ("10.0.0.1"));
+  rrep.SetDst (Ipv4Address ("10.0.0.9"));
+  rrep.SetMetric (3.5);
+  BenchParse ("parse-rrep", rrep, routing, sender, ops);
+
+  DlarpHeader agreement (DLARPTYPE_AGREEMENT);
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      DlarpAgreementRecord record;
+      record.dst = Destination (i);
+      record.nextHop = Ipv4Address ("10.0.0.3");
+      record.seqNo = i;
+      record.metric = 2.5;
+      agreement.AddAgreementRecord (record);
+    }
+  BenchParse ("parse-agreement", agreement, routing, sender, ops);
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+  uint32_t minDestinations = 10;
+  uint32_t maxDestinations = 100000;
+  uint64_t ops = 1000000;
+  std::string output;
+
+  CommandLine cmd;
+  cmd.AddValue ("minDestinations", "Smallest routing table size", minDestinations);
+  cmd.AddValue ("maxDestinations", "Largest routing table size; sizes grow tenfold", maxDestinations);
+  cmd.AddValue ("ops", "Operations per benchmark", ops);
+  cmd.AddValue ("output", "CSV output file (standard output if empty)", output);
+  cmd.Parse (argc, argv);
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      NS_ABORT_MSG_IF (!file, "Cannot open " << output);
+      g_out = &file;
+    }
+
+  // One node, one device, DLARP as its only routing protocol, and a
+  // second node on the same channel, without DLARP, that sends it the
+  // messages of the parsing benchmarks
+  NodeContainer nodes;
+  nodes.Create (2);
+  Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+  NetDeviceContainer devices;
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+      device->SetAddress (Mac48Address::Allocate ());
+      device->SetChannel (channel);
+      nodes.Get (i)->AddDevice (device);
+      devices.Add (device);
+    }
+  DlarpHelper dlarp;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dlarp);
+  stack.Install (nodes.Get (0));
+  InternetStackHelper plainStack;
+  plainStack.Install (nodes.Get (1));
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+  Ptr<DlarpRoutingProtocol> routing =
+    DynamicCast<DlarpRoutingProtocol> (nodes.Get (0)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+  NS_ABORT_MSG_IF (routing == 0, "DLARP is not the routing protocol of the node");
+  Ptr<Socket> sender = Socket::CreateSocket (nodes.Get (1), UdpSocketFactory::GetTypeId ());
+
+  *g_out << "benchmark,destinations,ops,ns_per_op,allocs_per_op,peak_rss_kb" << std::endl;
+  BenchParsing (routing, sender, ops);
+  for (uint32_t destinations = minDestinations; destinations <= maxDestinations; destinations *= 10)
+    {
+      BenchTable (destinations, ops);
+      BenchExpire (destinations);
+      BenchRoute (routing, devices.Get (0), destinations, ops);
+    }
+
+  Simulator::Destroy ();
+  return 0;
+}
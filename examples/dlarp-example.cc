@@ -1,4 +1,42 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * DLARP over a random waypoint ad hoc network: every node sends UDP echo
+ * requests to node 0.
+ *
+ * By default the run is headless: statistics are streamed, once per
+ * --statsInterval, to two CSV files, in memory that does not grow with
+ * the simulated time:
+ *
+ *   intervals (--intervalFile): time_s,tx_packets,rx_packets,rx_bytes,
+ *     throughput_kbps,mean_delay_ms,control_packets,control_bytes,
+ *     drops,routing_entries
+ *   flows (--flowFile), one line per flow active in the interval:
+ *     time_s,flow,src,dst,tx_packets,rx_packets,rx_bytes,mean_delay_ms
+ *
+ * A flow is the requests of one client; delays are measured from the
+ * client to the server.  The control_*, drops and routing_entries columns
+ * come from the DLARP counters of all the nodes.  NetAnim (--animation),
+ * DLARP logging (--verbose) and the FlowMonitor XML (--flowMonitor) are
+ * opt-in, and so are the binary routing table snapshots (--snapshotInterval),
+ * which dlarp-snapshot-to-csv converts to CSV.
+ *
+ * --auth makes every node authenticate its next hops with the M1-M3
+ * handshake before routing data through them, and --resumption=0 turns
+ * off session resumption: comparing the delay and throughput columns of
+ * the three runs gives the cost of the scheme.
+ *
+ * --controlMac appends a truncated MAC (--macSize bytes) to every DLARP
+ * message, and --macBatchInterval verifies the MACs received in each
+ * interval as one batch rather than one by one: the discovery latency
+ * printed at the end shows what batching costs the route discoveries.
+ *
+ * --linkFeedback=0 stops breaking links on Wi-Fi transmit failures, so
+ * that broken next hops are only noticed when their neighbor times out.
+ * --localRepair repairs a broken route at the node where it broke, with a
+ * discovery limited to a few hops, before reporting a RERR to the source.
+ * --expandingRing=0 floods every RREQ over the whole network instead of
+ * searching in rings of growing TTL first.
+ */
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
@@ -8,11 +46,274 @@
 #include "ns3/netanim-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/dlarp-helper.h"
+#include <fstream>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("DlarpExample");
 
+namespace {
+
+/// Flow and send time of an echo request
+class FlowTimestampTag : public Tag
+{
+public:
+  FlowTimestampTag () : m_flow (0), m_sent (0) {}
+  FlowTimestampTag (uint32_t flow, Time sent) : m_flow (flow), m_sent (sent.GetTimeStep ()) {}
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::DlarpExampleFlowTimestampTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("Dlarp")
+      .AddConstructor<FlowTimestampTag> ();
+    return tid;
+  }
+  virtual TypeId GetInstanceTypeId (void) const { return GetTypeId (); }
+  virtual uint32_t GetSerializedSize (void) const { return 12; }
+  virtual void Serialize (TagBuffer i) const
+  {
+    i.WriteU32 (m_flow);
+    i.WriteU64 (m_sent);
+  }
+  virtual void Deserialize (TagBuffer i)
+  {
+    m_flow = i.ReadU32 ();
+    m_sent = i.ReadU64 ();
+  }
+  virtual void Print (std::ostream &os) const { os << "flow=" << m_flow << " sent=" << m_sent; }
+
+  /// \return the flow of the packet
+  uint32_t GetFlow (void) const { return m_flow; }
+  /// \return when the packet was sent
+  Time GetSent (void) const { return TimeStep (m_sent); }
+
+private:
+  uint32_t m_flow;      //!< Flow index
+  int64_t m_sent;       //!< Send time, in time steps
+};
+
+/**
+ * \brief Streams per-interval and per-flow statistics to CSV files
+ *
+ * Counters are kept per flow for the current interval and for the whole
+ * run only, and written out at the end of every interval.
+ */
+class StreamingStats
+{
+public:
+  /**
+   * \param intervalFile the per-interval CSV file
+   * \param flowFile the per-flow CSV file
+   * \param interval the length of an interval
+   * \param dlarp the helper that installed DLARP
+   * \param nodes the nodes whose DLARP counters are reported
+   */
+  StreamingStats (std::string intervalFile, std::string flowFile, Time interval,
+                  const DlarpHelper &dlarp, NodeContainer nodes)
+    : m_interval (interval),
+      m_dlarp (dlarp),
+      m_nodes (nodes),
+      m_lastDrops (0)
+  {
+    m_intervalCsv.open (intervalFile.c_str ());
+    NS_ABORT_MSG_IF (!m_intervalCsv, "Cannot open " << intervalFile);
+    m_flowCsv.open (flowFile.c_str ());
+    NS_ABORT_MSG_IF (!m_flowCsv, "Cannot open " << flowFile);
+    m_intervalCsv << "time_s,tx_packets,rx_packets,rx_bytes,throughput_kbps,mean_delay_ms,"
+                  << "control_packets,control_bytes,drops,routing_entries" << std::endl;
+    m_flowCsv << "time_s,flow,src,dst,tx_packets,rx_packets,rx_bytes,mean_delay_ms" << std::endl;
+  }
+
+  /**
+   * \brief Declare a flow
+   * \param src its source address
+   * \param dst its destination address
+   * \return its index
+   */
+  uint32_t AddFlow (Ipv4Address src, Ipv4Address dst)
+  {
+    Flow flow;
+    flow.src = src;
+    flow.dst = dst;
+    m_flows.push_back (flow);
+    return m_flows.size () - 1;
+  }
+
+  /// \brief Start writing an interval every interval
+  void Start (void)
+  {
+    m_intervalStart = Simulator::Now ();
+    m_event = Simulator::Schedule (m_interval, &StreamingStats::Flush, this);
+  }
+
+  /// \brief Write the last, possibly partial, interval
+  void Finish (void)
+  {
+    m_event.Cancel ();
+    if (Simulator::Now () > m_intervalStart)
+      {
+        Write ();
+      }
+  }
+
+  /**
+   * \brief Count a packet sent by a flow, and tag it
+   * \param stats the sink
+   * \param flow the flow index
+   * \param packet the packet
+   */
+  static void Tx (StreamingStats *stats, uint32_t flow, Ptr<const Packet> packet)
+  {
+    packet->AddPacketTag (FlowTimestampTag (flow, Simulator::Now ()));
+    stats->m_flows[flow].current.txPackets++;
+    stats->m_flows[flow].total.txPackets++;
+  }
+
+  /**
+   * \brief Count a packet received by a sink
+   * \param stats the sink
+   * \param packet the packet, tagged by Tx
+   */
+  static void Rx (StreamingStats *stats, Ptr<const Packet> packet)
+  {
+    FlowTimestampTag tag;
+    if (!packet->PeekPacketTag (tag) || tag.GetFlow () >= stats->m_flows.size ())
+      {
+        return;
+      }
+    Time delay = Simulator::Now () - tag.GetSent ();
+    Flow &flow = stats->m_flows[tag.GetFlow ()];
+    flow.current.Receive (packet->GetSize (), delay);
+    flow.total.Receive (packet->GetSize (), delay);
+  }
+
+  /// \return the number of packets sent by every flow
+  uint64_t GetTxPackets (void) const
+  {
+    uint64_t total = 0;
+    for (std::vector<Flow>::const_iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+      {
+        total += f->total.txPackets;
+      }
+    return total;
+  }
+
+  /// \return the number of packets received from every flow
+  uint64_t GetRxPackets (void) const
+  {
+    uint64_t total = 0;
+    for (std::vector<Flow>::const_iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+      {
+        total += f->total.rxPackets;
+      }
+    return total;
+  }
+
+  /// \return the mean delay of every packet received
+  Time GetMeanDelay (void) const
+  {
+    Counters all;
+    for (std::vector<Flow>::const_iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+      {
+        all.rxPackets += f->total.rxPackets;
+        all.delaySum += f->total.delaySum;
+      }
+    return all.GetMeanDelay ();
+  }
+
+private:
+  /// Counters of a flow over some time
+  struct Counters
+  {
+    Counters () : txPackets (0), rxPackets (0), rxBytes (0) {}
+    void Receive (uint32_t bytes, Time delay)
+    {
+      rxPackets++;
+      rxBytes += bytes;
+      delaySum += delay;
+    }
+    Time GetMeanDelay (void) const
+    {
+      return rxPackets > 0 ? delaySum / int64_t (rxPackets) : Time ();
+    }
+    uint64_t txPackets;        //!< Packets sent
+    uint64_t rxPackets;        //!< Packets received
+    uint64_t rxBytes;          //!< Bytes received
+    Time delaySum;             //!< Sum of the delays of the packets received
+  };
+
+  /// A flow and its counters
+  struct Flow
+  {
+    Ipv4Address src;           //!< Source address
+    Ipv4Address dst;           //!< Destination address
+    Counters current;          //!< Counters of the current interval
+    Counters total;            //!< Counters of the whole run
+  };
+
+  /// \brief Write the interval that just ended and start the next one
+  void Flush (void)
+  {
+    Write ();
+    m_event = Simulator::Schedule (m_interval, &StreamingStats::Flush, this);
+  }
+
+  /// \brief Write the current interval and reset its counters
+  void Write (void)
+  {
+    double now = Simulator::Now ().GetSeconds ();
+    double length = now - m_intervalStart.GetSeconds ();
+    Counters all;
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        Counters &c = m_flows[i].current;
+        if (c.txPackets == 0 && c.rxPackets == 0)
+          {
+            continue;
+          }
+        m_flowCsv << now << "," << i << "," << m_flows[i].src << "," << m_flows[i].dst << ","
+                  << c.txPackets << "," << c.rxPackets << "," << c.rxBytes << ","
+                  << c.GetMeanDelay ().GetSeconds () * 1000 << "\n";
+        all.txPackets += c.txPackets;
+        all.rxPackets += c.rxPackets;
+        all.rxBytes += c.rxBytes;
+        all.delaySum += c.delaySum;
+        c = Counters ();
+      }
+
+    DlarpStats dlarp = m_dlarp.GetStats (m_nodes);
+    uint64_t drops = 0;
+    for (uint32_t r = 0; r < DlarpStats::DROP_REASON_COUNT; ++r)
+      {
+        drops += dlarp.drops[r];
+      }
+    m_intervalCsv << now << "," << all.txPackets << "," << all.rxPackets << "," << all.rxBytes << ","
+                  << (length > 0 ? all.rxBytes * 8.0 / length / 1000 : 0) << ","
+                  << all.GetMeanDelay ().GetSeconds () * 1000 << ","
+                  << dlarp.GetTxPackets () - m_lastDlarp.GetTxPackets () << ","
+                  << dlarp.GetTxBytes () - m_lastDlarp.GetTxBytes () << ","
+                  << drops - m_lastDrops << "," << dlarp.tableSize << "\n";
+    m_lastDlarp = dlarp;
+    m_lastDrops = drops;
+    m_intervalStart = Simulator::Now ();
+  }
+
+  Time m_interval;                     //!< Length of an interval
+  Time m_intervalStart;                //!< Start of the current interval
+  EventId m_event;                     //!< End of the current interval
+  DlarpHelper m_dlarp;                 //!< Helper that aggregates the DLARP counters
+  NodeContainer m_nodes;               //!< Nodes whose DLARP counters are reported
+  DlarpStats m_lastDlarp;              //!< DLARP counters at the start of the interval
+  uint64_t m_lastDrops;                //!< DLARP drops at the start of the interval
+  std::vector<Flow> m_flows;           //!< Flows, by index
+  std::ofstream m_intervalCsv;         //!< Per-interval output
+  std::ofstream m_flowCsv;             //!< Per-flow output
+};
+
+} // namespace
+
 int main (int argc, char *argv[])
 {
   // Set simulation parameters
@@ -23,7 +324,22 @@ int main (int argc, char *argv[])
   double pktInterval = 1.0;  // seconds
   uint32_t packetSize = 1024;  // bytes
   std::string phyMode = "DsssRate1Mbps";
-  bool enableFlowMonitor = true;
+  bool enableFlowMonitor = false;
+  bool enableAnimation = false;
+  bool verbose = false;
+  double statsInterval = 1.0;  // seconds
+  std::string intervalFile = "dlarp-intervals.csv";
+  std::string flowFile = "dlarp-flows.csv";
+  double snapshotInterval = 0;  // seconds, 0 disables the snapshots
+  std::string snapshotFile = "dlarp-snapshots.bin";
+  bool auth = false;
+  bool resumption = true;
+  bool controlMac = false;
+  uint32_t macSize = 8;
+  double macBatchInterval = 0;  // seconds, 0 verifies every message at once
+  bool linkFeedback = true;
+  bool localRepair = false;
+  bool expandingRing = true;
   
   // Parse command line arguments
   CommandLine cmd;
@@ -32,11 +348,30 @@ int main (int argc, char *argv[])
   cmd.AddValue ("nodeSpeed", "Node maximum speed in m/s", nodeSpeed);
   cmd.AddValue ("packetSize", "UDP packet size in bytes", packetSize);
   cmd.AddValue ("pktInterval", "Packet interval in seconds", pktInterval);
+  cmd.AddValue ("statsInterval", "Interval of the streamed statistics in seconds", statsInterval);
+  cmd.AddValue ("intervalFile", "CSV file of the per-interval statistics", intervalFile);
+  cmd.AddValue ("flowFile", "CSV file of the per-flow statistics", flowFile);
+  cmd.AddValue ("snapshotInterval", "Interval of the routing table snapshots in seconds (0: none)", snapshotInterval);
+  cmd.AddValue ("snapshotFile", "Binary file of the routing table snapshots", snapshotFile);
+  cmd.AddValue ("auth", "Authenticate the next hops with the M1-M3 handshake", auth);
+  cmd.AddValue ("resumption", "Resume the sessions with neighbors that come back", resumption);
+  cmd.AddValue ("controlMac", "Append a truncated MAC to every DLARP message", controlMac);
+  cmd.AddValue ("macSize", "Size of the truncated MAC in bytes", macSize);
+  cmd.AddValue ("macBatchInterval", "Interval of the batched MAC verification in seconds (0: none)", macBatchInterval);
+  cmd.AddValue ("linkFeedback", "Break links on Wi-Fi transmit failures", linkFeedback);
+  cmd.AddValue ("localRepair", "Repair broken routes where they broke", localRepair);
+  cmd.AddValue ("expandingRing", "Search for routes in rings of growing TTL", expandingRing);
+  cmd.AddValue ("animation", "Write a NetAnim trace with packet metadata", enableAnimation);
+  cmd.AddValue ("verbose", "Enable DLARP and example logging", verbose);
+  cmd.AddValue ("flowMonitor", "Write the FlowMonitor XML with histograms and probes", enableFlowMonitor);
   cmd.Parse (argc, argv);
   
   // Enable logging
-  LogComponentEnable ("DlarpRoutingProtocol", LOG_LEVEL_INFO);
-  LogComponentEnable ("DlarpExample", LOG_LEVEL_INFO);
+  if (verbose)
+    {
+      LogComponentEnable ("DlarpRoutingProtocol", LOG_LEVEL_INFO);
+      LogComponentEnable ("DlarpExample", LOG_LEVEL_INFO);
+    }
   
   // Create nodes
   NS_LOG_INFO ("Creating " << nNodes << " nodes...");
@@ -83,6 +418,14 @@ int main (int argc, char *argv[])
   // Install Internet stack with DLARP
   InternetStackHelper internet;
   DlarpHelper dlarp;
+  dlarp.Set ("Authentication", BooleanValue (auth));
+  dlarp.Set ("SessionResumption", BooleanValue (resumption));
+  dlarp.Set ("ControlMac", BooleanValue (controlMac));
+  dlarp.Set ("MacSize", UintegerValue (macSize));
+  dlarp.Set ("MacBatchInterval", TimeValue (Seconds (macBatchInterval)));
+  dlarp.Set ("LinkLayerFeedback", BooleanValue (linkFeedback));
+  dlarp.Set ("LocalRepair", BooleanValue (localRepair));
+  dlarp.Set ("ExpandingRing", BooleanValue (expandingRing));
   internet.SetRoutingHelper (dlarp);
   internet.Install (nodes);
   
@@ -91,12 +434,20 @@ int main (int argc, char *argv[])
   ipv4.SetBase ("10.1.1.0", "255.255.255.0");
   Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
   
+  // Routing and neighbor tables, for offline analysis with dlarp-snapshot-to-csv
+  if (snapshotInterval > 0)
+    {
+      dlarp.EnableSnapshots (nodes, snapshotFile, Seconds (snapshotInterval));
+    }
+  
   // Set up application
   uint16_t port = 9;
   
   // Create a UDP server on node 0
   UdpEchoServerHelper echoServer (port);
   ApplicationContainer serverApps = echoServer.Install (nodes.Get (0));
+  StreamingStats stats (intervalFile, flowFile, Seconds (statsInterval), dlarp, nodes);
+  serverApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&StreamingStats::Rx, &stats));
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (simTime));
   
@@ -109,15 +460,22 @@ int main (int argc, char *argv[])
   ApplicationContainer clientApps;
   for (uint32_t i = 1; i < nNodes; i++)
     {
-      clientApps.Add (echoClient.Install (nodes.Get (i)));
+      ApplicationContainer client = echoClient.Install (nodes.Get (i));
+      uint32_t flow = stats.AddFlow (interfaces.GetAddress (i), interfaces.GetAddress (0));
+      client.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&StreamingStats::Tx, &stats, flow));
+      clientApps.Add (client);
     }
   
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (simTime));
   
   // Enable NetAnim animation
-  AnimationInterface anim ("dlarp-animation.xml");
-  anim.EnablePacketMetadata (true);
+  AnimationInterface *anim = 0;
+  if (enableAnimation)
+    {
+      anim = new AnimationInterface ("dlarp-animation.xml");
+      anim->EnablePacketMetadata (true);
+    }
   
   // Setup flow monitor
   Ptr<FlowMonitor> flowMonitor;
@@ -130,7 +488,17 @@ int main (int argc, char *argv[])
   // Run simulation
   NS_LOG_INFO ("Starting simulation for " << simTime << " s ...");
   Simulator::Stop (Seconds (simTime));
+  stats.Start ();
   Simulator::Run ();
+  stats.Finish ();
+  
+  std::cout << "Tx packets: " << stats.GetTxPackets () << ", Rx packets: " << stats.GetRxPackets ()
+            << ", PDR: " << (stats.GetTxPackets () > 0 ? 100.0 * stats.GetRxPackets () / stats.GetTxPackets () : 0)
+            << "%, mean delay: " << stats.GetMeanDelay ().As (Time::MS) << std::endl;
+  DlarpStats counters = dlarp.GetStats (nodes);
+  std::cout << "Route discoveries: " << counters.discoveriesSucceeded << " succeeded, mean latency "
+            << counters.GetMeanDiscoveryLatency ().As (Time::MS) << ", MAC verification delay "
+            << counters.GetMeanMacDelay ().As (Time::MS) << std::endl;
   
   // Print statistics
   if (enableFlowMonitor)
@@ -170,7 +538,10 @@ int main (int argc, char *argv[])
       flowMonitor->SerializeToXmlFile ("dlarp-flowmon.xml", true, true);
     }
   
+  NS_LOG_INFO ("DLARP counters of all nodes:\n" << dlarp.GetStats (nodes));
+  
   Simulator::Destroy ();
+  delete anim;
   
   return 0;
 }
\ No newline at end of file
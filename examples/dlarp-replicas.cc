@@ -0,0 +1,407 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Independent replicas of a DLARP scenario, run in parallel on the local
+ * cores.  Every replica is a forked child process with its own RngRun
+ * value (firstRun, firstRun + 1, ...) and runs the scenario of
+ * dlarp-scenario.h, shared with dlarp-scalability, whose random variables
+ * all get fixed stream numbers: a replica is reproducible from its run
+ * number alone.  The children report their metrics through a pipe, and
+ * the parent merges them into a CSV summary:
+ *
+ *   metric,replicas,mean,stddev,ci_low,ci_high
+ *
+ * where [ci_low, ci_high] is the Student t confidence interval of the mean
+ * at the --confidence level.  The per-replica values can be kept with
+ * --replicaOutput, one "run,metric,value" line each.
+ */
+
+#include "ns3/core-module.h"
+#include "dlarp-scenario.h"
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DlarpReplicas");
+
+namespace {
+
+/// Metrics of one replica, by name
+typedef std::map<std::string, double> Metrics;
+
+/**
+ * \brief Run one replica of the scenario, in the current process
+ * \param run the RngRun value of the replica
+ * \param params the scenario parameters
+ * \return the metrics of the replica
+ */
+Metrics
+RunReplica (uint64_t run, const DlarpScenarioParameters &params)
+{
+  RngSeedManager::SetRun (run);
+  DlarpScenarioResults results = DlarpScenario (params).Run ();
+
+  Metrics metrics;
+  metrics["pdr"] = results.dataTx > 0 ? double (results.dataRx) / results.dataTx : 0;
+  metrics["data_tx"] = results.dataTx;
+  metrics["data_rx"] = results.dataRx;
+  metrics["control_packets"] = results.controlPackets;
+  metrics["control_bytes"] = results.controlBytes;
+  metrics["control_bytes_per_rx"] = results.dataRx > 0 ? double (results.controlBytes) / results.dataRx : 0;
+  metrics["events"] = results.events;
+  metrics["wall_clock_s"] = results.wallClock;
+  return metrics;
+}
+
+/// A replica running in a child process
+struct Child
+{
+  uint64_t run;            //!< RngRun value of the replica
+  pid_t pid;               //!< Process of the replica
+  int fd;                  //!< Read end of its pipe
+  std::string output;      //!< What it has written so far
+};
+
+/**
+ * \brief Fork the child process of a replica
+ * \param run the RngRun value of the replica
+ * \param params the scenario parameters
+ * \return the child
+ */
+Child
+StartReplica (uint64_t run, const DlarpScenarioParameters &params)
+{
+  int fds[2];
+  NS_ABORT_MSG_IF (pipe (fds) != 0, "pipe failed");
+  pid_t pid = fork ();
+  NS_ABORT_MSG_IF (pid < 0, "fork failed");
+  if (pid == 0)
+    {
+      close (fds[0]);
+      Metrics metrics = RunReplica (run, params);
+      std::ostringstream os;
+      os.precision (17);
+      for (Metrics::const_iterator i = metrics.begin (); i != metrics.end (); ++i)
+        {
+          os << i->first << " " << i->second << "\n";
+        }
+      std::string result = os.str ();
+      size_t done = 0;
+      while (done < result.size ())
+        {
+          ssize_t written = write (fds[1], result.data () + done, result.size () - done);
+          if (written <= 0)
+            {
+              _exit (1);
+            }
+          done += written;
+        }
+      close (fds[1]);
+      _exit (0);
+    }
+  close (fds[1]);
+  Child child;
+  child.run = run;
+  child.pid = pid;
+  child.fd = fds[0];
+  return child;
+}
+
+/**
+ * \brief Parse what a replica wrote
+ * \param output the text written by the child
+ * \param metrics receives its metrics
+ * \return true if the text was well formed and not empty
+ */
+bool
+ParseMetrics (const std::string &output, Metrics &metrics)
+{
+  std::istringstream is (output);
+  std::string name;
+  double value;
+  while (is >> name >> value)
+    {
+      metrics[name] = value;
+    }
+  return is.eof () && !metrics.empty ();
+}
+
+/**
+ * \brief Run the replicas, at most jobs of them at the same time
+ * \param firstRun the RngRun value of the first replica
+ * \param replicas the number of replicas
+ * \param jobs the maximum number of concurrent children
+ * \param params the scenario parameters
+ * \return the metrics of the replicas that succeeded, by run
+ */
+std::map<uint64_t, Metrics>
+RunReplicas (uint64_t firstRun, uint32_t replicas, uint32_t jobs, const DlarpScenarioParameters &params)
+{
+  std::map<uint64_t, Metrics> results;
+  std::vector<Child> running;
+  uint32_t started = 0;
+  while (started < replicas || !running.empty ())
+    {
+      while (started < replicas && running.size () < jobs)
+        {
+          running.push_back (StartReplica (firstRun + started, params));
+          started++;
+        }
+      // Drain every pipe as it fills, so no child blocks on a full pipe
+      std::vector<struct pollfd> fds (running.size ());
+      for (size_t i = 0; i < running.size (); ++i)
+        {
+          fds[i].fd = running[i].fd;
+          fds[i].events = POLLIN;
+          fds[i].revents = 0;
+        }
+      if (poll (&fds[0], fds.size (), -1) < 0)
+        {
+          NS_ABORT_MSG_IF (errno != EINTR, "poll failed");
+          continue;
+        }
+      std::vector<Child> stillRunning;
+      for (size_t i = 0; i < running.size (); ++i)
+        {
+          Child &child = running[i];
+          if (fds[i].revents == 0)
+            {
+              stillRunning.push_back (child);
+              continue;
+            }
+          char buffer[4096];
+          ssize_t n = read (child.fd, buffer, sizeof (buffer));
+          if (n > 0 || (n < 0 && errno == EINTR))
+            {
+              if (n > 0)
+                {
+                  child.output.append (buffer, n);
+                }
+              stillRunning.push_back (child);
+              continue;
+            }
+          NS_ABORT_MSG_IF (n < 0, "read failed");
+          // End of file: the replica is done
+          close (child.fd);
+          int status = 0;
+          while (waitpid (child.pid, &status, 0) < 0)
+            {
+              NS_ABORT_MSG_IF (errno != EINTR, "waitpid failed");
+            }
+          Metrics metrics;
+          if (WIFEXITED (status) && WEXITSTATUS (status) == 0 && ParseMetrics (child.output, metrics))
+            {
+              results[child.run] = metrics;
+            }
+          else
+            {
+              std::cerr << "Replica with RngRun " << child.run << " failed" << std::endl;
+            }
+        }
+      running.swap (stillRunning);
+    }
+  return results;
+}
+
+/**
+ * \brief Continued fraction of the regularized incomplete beta function
+ * (Lentz's method)
+ */
+double
+BetaContinuedFraction (double a, double b, double x)
+{
+  const double tiny = 1e-300;
+  double qab = a + b;
+  double qap = a + 1;
+  double qam = a - 1;
+  double c = 1;
+  double d = 1 - qab * x / qap;
+  d = std::fabs (d) < tiny ? tiny : d;
+  d = 1 / d;
+  double h = d;
+  for (int m = 1; m <= 300; ++m)
+    {
+      int m2 = 2 * m;
+      double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+      d = 1 + aa * d;
+      d = std::fabs (d) < tiny ? tiny : d;
+      c = 1 + aa / c;
+      c = std::fabs (c) < tiny ? tiny : c;
+      d = 1 / d;
+      h *= d * c;
+      aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+      d = 1 + aa * d;
+      d = std::fabs (d) < tiny ? tiny : d;
+      c = 1 + aa / c;
+      c = std::fabs (c) < tiny ? tiny : c;
+      d = 1 / d;
+      double del = d * c;
+      h *= del;
+      if (std::fabs (del - 1) < 1e-12)
+        {
+          break;
+        }
+    }
+  return h;
+}
+
+/// \return the regularized incomplete beta function I_x(a, b)
+double
+IncompleteBeta (double a, double b, double x)
+{
+  if (x <= 0 || x >= 1)
+    {
+      return x <= 0 ? 0 : 1;
+    }
+  double front = std::exp (std::lgamma (a + b) - std::lgamma (a) - std::lgamma (b)
+                           + a * std::log (x) + b * std::log (1 - x));
+  if (x < (a + 1) / (a + b + 2))
+    {
+      return front * BetaContinuedFraction (a, b, x) / a;
+    }
+  return 1 - front * BetaContinuedFraction (b, a, 1 - x) / b;
+}
+
+/**
+ * \param p a probability in (0.5, 1)
+ * \param df the degrees of freedom
+ * \return the p quantile of the Student t distribution, by bisection of
+ * its CDF
+ */
+double
+StudentTQuantile (double p, double df)
+{
+  double low = 0;
+  double high = 1;
+  // P(T <= t) = 1 - I_{df/(df+t^2)}(df/2, 1/2) / 2 for t >= 0
+  while (1 - 0.5 * IncompleteBeta (df / 2, 0.5, df / (df + high * high)) < p)
+    {
+      high *= 2;
+    }
+  for (int i = 0; i < 100; ++i)
+    {
+      double mid = (low + high) / 2;
+      if (1 - 0.5 * IncompleteBeta (df / 2, 0.5, df / (df + mid * mid)) < p)
+        {
+          low = mid;
+        }
+      else
+        {
+          high = mid;
+        }
+    }
+  return (low + high) / 2;
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+  DlarpScenarioParameters params;
+  params.nNodes = 20;
+  params.side = 500;
+  params.simTime = 100.0;
+  params.nodeSpeed = 5.0;
+  params.nFlows = 10;
+  params.packetSize = 512;
+  params.pktInterval = 1.0;
+  uint32_t replicas = 30;
+  uint64_t firstRun = 1;
+  long cores = sysconf (_SC_NPROCESSORS_ONLN);
+  uint32_t jobs = cores > 0 ? cores : 1;
+  double confidence = 0.95;
+  std::string output = "dlarp-replicas.csv";
+  std::string replicaOutput;
+
+  CommandLine cmd;
+  cmd.AddValue ("nNodes", "Number of nodes", params.nNodes);
+  cmd.AddValue ("side", "Side of the square area, in metres", params.side);
+  cmd.AddValue ("simTime", "Simulation time of every replica, in seconds", params.simTime);
+  cmd.AddValue ("nodeSpeed", "Node maximum speed in m/s", params.nodeSpeed);
+  cmd.AddValue ("nFlows", "Number of CBR flows between random node pairs", params.nFlows);
+  cmd.AddValue ("packetSize", "UDP packet size in bytes", params.packetSize);
+  cmd.AddValue ("pktInterval", "Packet interval of a flow in seconds", params.pktInterval);
+  cmd.AddValue ("replicas", "Number of independent replicas", replicas);
+  cmd.AddValue ("firstRun", "RngRun value of the first replica", firstRun);
+  cmd.AddValue ("jobs", "Replicas run at the same time (default: online cores)", jobs);
+  cmd.AddValue ("confidence", "Confidence level of the intervals", confidence);
+  cmd.AddValue ("output", "CSV summary file", output);
+  cmd.AddValue ("replicaOutput", "CSV file of the per-replica values (none if empty)", replicaOutput);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (replicas == 0, "At least one replica is needed");
+  NS_ABORT_MSG_IF (confidence <= 0 || confidence >= 1, "The confidence level must be in (0, 1)");
+  jobs = std::max<uint32_t> (1, std::min (jobs, replicas));
+
+  std::map<uint64_t, Metrics> results = RunReplicas (firstRun, replicas, jobs, params);
+  NS_ABORT_MSG_IF (results.empty (), "Every replica failed");
+
+  if (!replicaOutput.empty ())
+    {
+      std::ofstream raw (replicaOutput.c_str ());
+      NS_ABORT_MSG_IF (!raw, "Cannot open " << replicaOutput);
+      raw.precision (17);
+      raw << "run,metric,value" << std::endl;
+      for (std::map<uint64_t, Metrics>::const_iterator r = results.begin (); r != results.end (); ++r)
+        {
+          for (Metrics::const_iterator m = r->second.begin (); m != r->second.end (); ++m)
+            {
+              raw << r->first << "," << m->first << "," << m->second << std::endl;
+            }
+        }
+    }
+
+  // Group the values by metric
+  std::map<std::string, std::vector<double> > samples;
+  for (std::map<uint64_t, Metrics>::const_iterator r = results.begin (); r != results.end (); ++r)
+    {
+      for (Metrics::const_iterator m = r->second.begin (); m != r->second.end (); ++m)
+        {
+          samples[m->first].push_back (m->second);
+        }
+    }
+
+  std::ofstream csv (output.c_str ());
+  NS_ABORT_MSG_IF (!csv, "Cannot open " << output);
+  csv << "metric,replicas,mean,stddev,ci_low,ci_high" << std::endl;
+  std::cout << "metric,replicas,mean,stddev,ci_low,ci_high" << std::endl;
+  for (std::map<std::string, std::vector<double> >::const_iterator s = samples.begin (); s != samples.end (); ++s)
+    {
+      const std::vector<double> &values = s->second;
+      double n = values.size ();
+      double mean = 0;
+      for (size_t i = 0; i < values.size (); ++i)
+        {
+          mean += values[i];
+        }
+      mean /= n;
+      double variance = 0;
+      for (size_t i = 0; i < values.size (); ++i)
+        {
+          variance += (values[i] - mean) * (values[i] - mean);
+        }
+      double stddev = values.size () > 1 ? std::sqrt (variance / (n - 1)) : 0;
+      double halfWidth = 0;
+      if (values.size () > 1)
+        {
+          halfWidth = StudentTQuantile ((1 + confidence) / 2, n - 1) * stddev / std::sqrt (n);
+        }
+      std::ostringstream line;
+      line << s->first << "," << values.size () << "," << mean << "," << stddev << ","
+           << mean - halfWidth << "," << mean + halfWidth;
+      csv << line.str () << std::endl;
+      std::cout << line.str () << std::endl;
+    }
+  if (results.size () < replicas)
+    {
+      std::cerr << replicas - results.size () << " of " << replicas << " replicas failed" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Scalability sweep of DLARP: the same random-waypoint scenario is run for
+ * a list of node counts, at constant node density, with a fixed number of
+ * CBR flows between random node pairs.  Each point runs in its own child
+ * process, so that its peak RSS is its own, and appends one line to the
+ * CSV output:
+ *
+ *   nodes,area_side_m,sim_time_s,wall_clock_s,events,events_per_s,
+ *   peak_rss_kb,control_packets,control_bytes,data_tx,data_rx,pdr
+ *
+ * control_* counts the DLARP datagrams sent, IPv4 and UDP headers
+ * included; it is read from the DLARP counters once the point has run.
+ */
+
+#include "ns3/core-module.h"
+#include "dlarp-scenario.h"
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DlarpScalability");
+
+namespace {
+
+/// Parameters shared by every point of the sweep
+struct SweepParameters
+{
+  double density;          //!< Nodes per square kilometre
+  double simTime;          //!< Simulated seconds
+  double nodeSpeed;        //!< Maximum node speed, in m/s
+  uint32_t nFlows;         //!< Number of CBR flows
+  uint32_t packetSize;     //!< Data packet size, in bytes
+  double pktInterval;      //!< Seconds between the packets of a flow
+};
+
+/**
+ * \brief Run one point of the sweep
+ * \param nNodes the number of nodes
+ * \param params the sweep parameters
+ * \return its CSV line
+ */
+std::string
+RunPoint (uint32_t nNodes, const SweepParameters &params)
+{
+  // Constant density: the area grows with the node count
+  DlarpScenarioParameters scenario;
+  scenario.nNodes = nNodes;
+  scenario.side = std::sqrt (nNodes / params.density) * 1000.0;
+  scenario.simTime = params.simTime;
+  scenario.nodeSpeed = params.nodeSpeed;
+  scenario.nFlows = params.nFlows;
+  scenario.packetSize = params.packetSize;
+  scenario.pktInterval = params.pktInterval;
+  DlarpScenarioResults results = DlarpScenario (scenario).Run ();
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  std::ostringstream line;
+  line << nNodes << "," << scenario.side << "," << params.simTime << "," << results.wallClock << ","
+       << results.events << "," << (results.wallClock > 0 ? results.events / results.wallClock : 0) << ","
+       << usage.ru_maxrss << "," << results.controlPackets << "," << results.controlBytes << ","
+       << results.dataTx << "," << results.dataRx << ","
+       << (results.dataTx > 0 ? double (results.dataRx) / results.dataTx : 0);
+  return line.str ();
+}
+
+/**
+ * \brief Run one point in a child process
+ * \param nNodes the number of nodes
+ * \param params the sweep parameters
+ * \param line receives the CSV line of the point
+ * \return true if the child succeeded
+ */
+bool
+RunPointInChild (uint32_t nNodes, const SweepParameters &params, std::string &line)
+{
+  int fds[2];
+  NS_ABORT_MSG_IF (pipe (fds) != 0, "pipe failed");
+  pid_t pid = fork ();
+  NS_ABORT_MSG_IF (pid < 0, "fork failed");
+  if (pid == 0)
+    {
+      close (fds[0]);
+      std::string result = RunPoint (nNodes, params) + "\n";
+      ssize_t written = write (fds[1], result.data (), result.size ());
+      close (fds[1]);
+      _exit (written == ssize_t (result.size ()) ? 0 : 1);
+    }
+  close (fds[1]);
+  char buffer[512];
+  ssize_t n;
+  line.clear ();
+  while ((n = read (fds[0], buffer, sizeof (buffer))) != 0)
+    {
+      if (n > 0)
+        {
+          line.append (buffer, n);
+        }
+      else
+        {
+          NS_ABORT_MSG_IF (errno != EINTR, "read failed");
+        }
+    }
+  close (fds[0]);
+  int status = 0;
+  while (waitpid (pid, &status, 0) < 0)
+    {
+      NS_ABORT_MSG_IF (errno != EINTR, "waitpid failed");
+    }
+  if (!line.empty () && line[line.size () - 1] == '\n')
+    {
+      line.erase (line.size () - 1);
+    }
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0 && !line.empty ();
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+  std::string nodeCounts = "50,100,200,500,1000,2000";
+  SweepParameters params;
+  params.density = 80;          // 20 nodes on 500 m x 500 m, as in dlarp-example
+  params.simTime = 100.0;
+  params.nodeSpeed = 5.0;
+  params.nFlows = 10;
+  params.packetSize = 512;
+  params.pktInterval = 1.0;
+  std::string output = "dlarp-scalability.csv";
+
+  CommandLine cmd;
+  cmd.AddValue ("nodeCounts", "Comma-separated node counts of the sweep", nodeCounts);
+  cmd.AddValue ("density", "Nodes per square kilometre", params.density);
+  cmd.AddValue ("simTime", "Simulation time of every point, in seconds", params.simTime);
+  cmd.AddValue ("nodeSpeed", "Node maximum speed in m/s", params.nodeSpeed);
+  cmd.AddValue ("nFlows", "Number of CBR flows between random node pairs", params.nFlows);
+  cmd.AddValue ("packetSize", "UDP packet size in bytes", params.packetSize);
+  cmd.AddValue ("pktInterval", "Packet interval of a flow in seconds", params.pktInterval);
+  cmd.AddValue ("output", "CSV output file", output);
+  cmd.Parse (argc, argv);
+
+  std::ofstream csv (output.c_str ());
+  NS_ABORT_MSG_IF (!csv, "Cannot open " << output);
+  csv << "nodes,area_side_m,sim_time_s,wall_clock_s,events,events_per_s,"
+      << "peak_rss_kb,control_packets,control_bytes,data_tx,data_rx,pdr" << std::endl;
+
+  std::istringstream counts (nodeCounts);
+  std::string count;
+  while (std::getline (counts, count, ','))
+    {
+      uint32_t nNodes = std::stoul (count);
+      std::string line;
+      if (!RunPointInChild (nNodes, params, line))
+        {
+          std::cerr << "Sweep point with " << nNodes << " nodes failed" << std::endl;
+          continue;
+        }
+      csv << line << std::endl;
+      std::cout << line << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_SCENARIO_H
+#define DLARP_SCENARIO_H
+
+/*
+ * Random-waypoint scenario shared by dlarp-scalability and dlarp-replicas:
+ * nodes on an 802.11b ad hoc channel in a square area, running DLARP, with
+ * CBR flows between random pairs of distinct nodes.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/dlarp-helper.h"
+#include "ns3/dlarp-packet.h"
+#include <chrono>
+#include <set>
+#include <sstream>
+
+namespace ns3 {
+
+/// Parameters of the scenario
+struct DlarpScenarioParameters
+{
+  uint32_t nNodes;         //!< Number of nodes
+  double side;             //!< Side of the square area, in metres
+  double simTime;          //!< Simulated seconds
+  double nodeSpeed;        //!< Maximum node speed, in m/s
+  uint32_t nFlows;         //!< Number of CBR flows
+  uint32_t packetSize;     //!< Data packet size, in bytes
+  double pktInterval;      //!< Seconds between the packets of a flow
+};
+
+/// What a run of the scenario measured
+struct DlarpScenarioResults
+{
+  uint64_t controlPackets; //!< DLARP datagrams sent
+  uint64_t controlBytes;   //!< Bytes of the DLARP datagrams sent, IPv4 and UDP headers included
+  uint64_t dataTx;         //!< Data packets sent by the applications
+  uint64_t dataRx;         //!< Data packets received by the sinks
+  uint64_t events;         //!< Simulator events executed
+  double wallClock;        //!< Wall-clock seconds of Simulator::Run
+};
+
+/**
+ * \brief One run of the scenario, in the current process
+ *
+ * All the random variables, DLARP included, get fixed stream numbers: a
+ * run only depends on the RngRun value.  The control counters are read
+ * from DLARP once the run is over; only the data packets are counted
+ * while it runs.
+ */
+class DlarpScenario
+{
+public:
+  /**
+   * \brief Constructor
+   * \param params the scenario parameters
+   */
+  DlarpScenario (const DlarpScenarioParameters &params)
+    : m_params (params),
+      m_dataTx (0),
+      m_dataRx (0)
+  {
+  }
+
+  /**
+   * \brief Build the scenario, run it and destroy it
+   * \return what the run measured
+   */
+  DlarpScenarioResults Run (void)
+  {
+    NodeContainer nodes;
+    nodes.Create (m_params.nNodes);
+
+    WifiHelper wifi;
+    wifi.SetStandard (WIFI_STANDARD_80211b);
+    YansWifiPhyHelper wifiPhy;
+    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+    wifiPhy.SetChannel (wifiChannel.Create ());
+    WifiMacHelper wifiMac;
+    wifiMac.SetType ("ns3::AdhocWifiMac");
+    NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, nodes);
+
+    MobilityHelper mobility;
+    ObjectFactory pos;
+    pos.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+    std::stringstream ssRange;
+    ssRange << "ns3::UniformRandomVariable[Min=0.0|Max=" << m_params.side << "]";
+    pos.Set ("X", StringValue (ssRange.str ()));
+    pos.Set ("Y", StringValue (ssRange.str ()));
+    Ptr<PositionAllocator> positionAlloc = pos.Create ()->GetObject<PositionAllocator> ();
+    mobility.SetPositionAllocator (positionAlloc);
+    std::stringstream ssSpeed;
+    ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << m_params.nodeSpeed << "]";
+    mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+                               "Speed", StringValue (ssSpeed.str ()),
+                               "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
+                               "PositionAllocator", PointerValue (positionAlloc));
+    mobility.Install (nodes);
+
+    InternetStackHelper internet;
+    DlarpHelper dlarp;
+    internet.SetRoutingHelper (dlarp);
+    internet.Install (nodes);
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.1.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
+
+    int64_t stream = 0;
+    stream += wifi.AssignStreams (devices, stream);
+    stream += mobility.AssignStreams (nodes, stream);
+    stream += dlarp.AssignStreams (nodes, stream);
+    Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
+    pick->SetStream (stream++);
+
+    uint16_t port = 9;
+    std::stringstream ssRate;
+    ssRate << uint64_t (m_params.packetSize * 8 / m_params.pktInterval) << "bps";
+    ApplicationContainer sources;
+    ApplicationContainer sinks;
+    std::set<uint32_t> sinkNodes;
+    PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+    for (uint32_t f = 0; f < m_params.nFlows && m_params.nNodes > 1; ++f)
+      {
+        uint32_t src = pick->GetInteger (0, m_params.nNodes - 1);
+        uint32_t dst = pick->GetInteger (0, m_params.nNodes - 2);
+        dst = (dst >= src) ? dst + 1 : dst;
+        OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (interfaces.GetAddress (dst), port));
+        onoff.SetConstantRate (DataRate (ssRate.str ()), m_params.packetSize);
+        sources.Add (onoff.Install (nodes.Get (src)));
+        // One sink per destination node serves all its flows
+        if (sinkNodes.insert (dst).second)
+          {
+            sinks.Add (sink.Install (nodes.Get (dst)));
+          }
+      }
+    sinks.Start (Seconds (1.0));
+    sources.Start (Seconds (2.0));
+    sources.Stop (Seconds (m_params.simTime));
+
+    Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx",
+                                   MakeCallback (&DlarpScenario::DataTx, this));
+    Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx",
+                                   MakeCallback (&DlarpScenario::DataRx, this));
+
+    Simulator::Stop (Seconds (m_params.simTime));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    Simulator::Run ();
+    DlarpScenarioResults results;
+    results.wallClock = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+    results.events = Simulator::GetEventCount ();
+
+    DlarpStats stats = dlarp.GetStats (nodes);
+    results.controlPackets = stats.txDatagrams;
+    results.controlBytes = stats.GetTxBytes () + DLARP_UDP_IPV4_HEADER_SIZE * stats.txDatagrams;
+    results.dataTx = m_dataTx;
+    results.dataRx = m_dataRx;
+    Simulator::Destroy ();
+    return results;
+  }
+
+private:
+  /// Count a data packet sent
+  void DataTx (Ptr<const Packet> packet)
+  {
+    m_dataTx++;
+  }
+  /// Count a data packet received
+  void DataRx (Ptr<const Packet> packet, const Address &from)
+  {
+    m_dataRx++;
+  }
+
+  DlarpScenarioParameters m_params; //!< Scenario parameters
+  uint64_t m_dataTx;                //!< Data packets sent so far
+  uint64_t m_dataRx;                //!< Data packets received so far
+};
+
+} // namespace ns3
+
+#endif /* DLARP_SCENARIO_H */
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Convert a DLARP snapshot file, written by DlarpHelper::EnableSnapshots,
+ * to CSV:
+ *
+ *   time_s,node,kind,address,next_hop,interface,seq_no,metric,lifetime_ms,best
+ *
+ * kind is "route" or "neighbor".  The file is mapped in memory and read
+ * as an array of DlarpSnapshotRecord; --node keeps the records of one
+ * node only.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/dlarp-snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DlarpSnapshotToCsv");
+
+namespace {
+
+/**
+ * \brief Print an IPv4 address in dotted notation
+ * \param out the output
+ * \param address the address, in host byte order
+ */
+void
+PrintAddress (std::FILE *out, uint32_t address)
+{
+  std::fprintf (out, "%u.%u.%u.%u", address >> 24, (address >> 16) & 0xff, (address >> 8) & 0xff, address & 0xff);
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+  std::string input = "dlarp-snapshots.bin";
+  std::string output;
+  int64_t node = -1;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Snapshot file", input);
+  cmd.AddValue ("output", "CSV output file (standard output if empty)", output);
+  cmd.AddValue ("node", "Only convert the records of this node (all if negative)", node);
+  cmd.Parse (argc, argv);
+
+  int fd = open (input.c_str (), O_RDONLY);
+  NS_ABORT_MSG_IF (fd < 0, "Cannot open " << input);
+  struct stat st;
+  NS_ABORT_MSG_IF (fstat (fd, &st) != 0, "Cannot stat " << input);
+  size_t size = st.st_size;
+  NS_ABORT_MSG_IF (size < sizeof (DlarpSnapshotFileHeader), input << " is not a DLARP snapshot file");
+  void *map = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  NS_ABORT_MSG_IF (map == MAP_FAILED, "Cannot map " << input);
+  close (fd);
+
+  const DlarpSnapshotFileHeader *header = static_cast<const DlarpSnapshotFileHeader *> (map);
+  NS_ABORT_MSG_IF (std::memcmp (header->magic, "DLARPSNP", sizeof (header->magic)) != 0,
+                   input << " is not a DLARP snapshot file");
+  NS_ABORT_MSG_IF (header->byteOrder != DlarpSnapshotFileHeader::BYTE_ORDER_MARK,
+                   input << " was written on a host of another byte order");
+  NS_ABORT_MSG_IF (header->version != DlarpSnapshotFileHeader::VERSION
+                   || header->recordSize != sizeof (DlarpSnapshotRecord),
+                   input << " has an unsupported format version " << header->version);
+
+  const DlarpSnapshotRecord *records =
+    reinterpret_cast<const DlarpSnapshotRecord *> (static_cast<const char *> (map) + sizeof (DlarpSnapshotFileHeader));
+  size_t n = (size - sizeof (DlarpSnapshotFileHeader)) / sizeof (DlarpSnapshotRecord);
+
+  std::FILE *out = stdout;
+  if (!output.empty ())
+    {
+      out = std::fopen (output.c_str (), "w");
+      NS_ABORT_MSG_IF (out == 0, "Cannot open " << output);
+    }
+  std::fprintf (out, "time_s,node,kind,address,next_hop,interface,seq_no,metric,lifetime_ms,best\n");
+  for (size_t i = 0; i < n; ++i)
+    {
+      const DlarpSnapshotRecord &r = records[i];
+      if (node >= 0 && r.node != node)
+        {
+          continue;
+        }
+      std::fprintf (out, "%.9f,%u,%s,", r.time / 1e9, r.node,
+                    r.kind == DlarpSnapshotRecord::ROUTE ? "route" : "neighbor");
+      PrintAddress (out, r.address);
+      std::fputc (',', out);
+      PrintAddress (out, r.nextHop);
+      std::fprintf (out, ",%u,%u,%g,%d,%d\n", unsigned (r.interface), r.seqNo, r.metric, r.lifetime,
+                    (r.flags & DlarpSnapshotRecord::FLAG_BEST) ? 1 : 0);
+    }
+  if (out != stdout)
+    {
+      std::fclose (out);
+    }
+  munmap (map, size);
+  return 0;
+}
@@ -2,4 +2,16 @@
 
 def build(bld):
     obj = bld.create_ns3_program('dlarp-example', ['dlarp', 'internet', 'wifi', 'netanim', 'flow-monitor'])
-    obj.source = 'dlarp-example.cc'
\ No newline at end of file
+    obj.source = 'dlarp-example.cc'
+
+    obj = bld.create_ns3_program('dlarp-bench', ['dlarp', 'internet', 'network'])
+    obj.source = 'dlarp-bench.cc'
+
+    obj = bld.create_ns3_program('dlarp-scalability', ['dlarp', 'internet', 'wifi', 'mobility', 'applications'])
+    obj.source = 'dlarp-scalability.cc'
+
+    obj = bld.create_ns3_program('dlarp-replicas', ['dlarp', 'internet', 'wifi', 'mobility', 'applications'])
+    obj.source = 'dlarp-replicas.cc'
+
+    obj = bld.create_ns3_program('dlarp-snapshot-to-csv', ['dlarp', 'core'])
+    obj.source = 'dlarp-snapshot-to-csv.cc'
@@ -5,6 +5,8 @@
 #include "ns3/ptr.h"
 #include "ns3/names.h"
 #include "ns3/node-list.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/simulator.h"
 
 namespace ns3 {
 
@@ -49,11 +51,82 @@ DlarpHelper::AssignStreams (NodeContainer c, int64_t stream)
       Ptr<DlarpRoutingProtocol> dlarp = DynamicCast<DlarpRoutingProtocol> (proto);
       if (dlarp)
         {
-          // Set stream for random variables - this would need to be implemented in the main protocol
-          // currentStream += dlarp->AssignStreams (currentStream);
+          currentStream += dlarp->AssignStreams (currentStream);
+          continue;
+        }
+      // DLARP may also be one of the protocols of a list routing
+      Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (proto);
+      if (list)
+        {
+          int16_t priority;
+          for (uint32_t j = 0; j < list->GetNRoutingProtocols (); j++)
+            {
+              Ptr<DlarpRoutingProtocol> listDlarp =
+                DynamicCast<DlarpRoutingProtocol> (list->GetRoutingProtocol (j, priority));
+              if (listDlarp)
+                {
+                  currentStream += listDlarp->AssignStreams (currentStream);
+                  break;
+                }
+            }
         }
     }
   return (currentStream - stream);
 }
 
+DlarpStats
+DlarpHelper::GetStats (NodeContainer c) const
+{
+  DlarpStats total;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      // Create aggregates the protocol to its node
+      Ptr<DlarpRoutingProtocol> dlarp = (*i)->GetObject<DlarpRoutingProtocol> ();
+      if (dlarp)
+        {
+          total += dlarp->GetStats ();
+        }
+    }
+  return total;
+}
+
+void
+DlarpHelper::ResetStats (NodeContainer c) const
+{
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<DlarpRoutingProtocol> dlarp = (*i)->GetObject<DlarpRoutingProtocol> ();
+      if (dlarp)
+        {
+          dlarp->ResetStats ();
+        }
+    }
+}
+
+void
+DlarpHelper::EnableSnapshots (NodeContainer c, std::string filename, Time interval) const
+{
+  Ptr<DlarpSnapshotWriter> writer = ns3::Create<DlarpSnapshotWriter> (filename);
+  Simulator::Schedule (interval, &DlarpHelper::Snapshot, writer, c, interval);
+}
+
+void
+DlarpHelper::Snapshot (Ptr<DlarpSnapshotWriter> writer, NodeContainer c, Time interval)
+{
+  std::vector<DlarpSnapshotRecord> &records = writer->GetBuffer ();
+  records.clear ();
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<DlarpRoutingProtocol> dlarp = (*i)->GetObject<DlarpRoutingProtocol> ();
+      if (dlarp)
+        {
+          dlarp->AppendSnapshot (records);
+        }
+    }
+  writer->Write (records);
+  // A run that ends without Simulator::Destroy still has every snapshot on disk
+  writer->Flush ();
+  Simulator::Schedule (interval, &DlarpHelper::Snapshot, writer, c, interval);
+}
+
 } // namespace ns3
\ No newline at end of file
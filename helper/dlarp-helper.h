@@ -6,6 +6,8 @@
 #include "ns3/node.h"
 #include "ns3/node-container.h"
 #include "ns3/ipv4-routing-helper.h"
+#include "ns3/dlarp-stats.h"
+#include "ns3/dlarp-snapshot.h"
 
 namespace ns3 {
 
@@ -47,7 +49,43 @@ public:
    */
   int64_t AssignStreams (NodeContainer c, int64_t stream);
   
+  /**
+   * \brief Sum the DLARP counters of a set of nodes
+   * \param c the nodes; those without DLARP are skipped
+   * \return the sum of their counters
+   */
+  DlarpStats GetStats (NodeContainer c) const;
+  
+  /**
+   * \brief Reset the DLARP counters of a set of nodes
+   * \param c the nodes; those without DLARP are skipped
+   */
+  void ResetStats (NodeContainer c) const;
+  
+  /**
+   * \brief Periodically write the routing and neighbor tables of a set of
+   * nodes to a snapshot file
+   *
+   * Every interval, starting at interval, one DlarpSnapshotRecord per
+   * candidate route and per neighbor of every node is appended to the
+   * file; see DlarpSnapshotWriter for its format.
+   *
+   * \param c the nodes; those without DLARP are skipped
+   * \param filename the snapshot file, truncated unless another call of
+   *        this run already writes to it
+   * \param interval the time between two snapshots
+   */
+  void EnableSnapshots (NodeContainer c, std::string filename, Time interval) const;
+  
 private:
+  /**
+   * \brief Write one snapshot, flush it to the file and schedule the next one
+   * \param writer the snapshot file
+   * \param c the nodes
+   * \param interval the time between two snapshots
+   */
+  static void Snapshot (Ptr<DlarpSnapshotWriter> writer, NodeContainer c, Time interval);
+  
   ObjectFactory m_agentFactory; //!< Object factory
 };
 
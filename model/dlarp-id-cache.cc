@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-id-cache.h"
+#include "ns3/simulator.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+DlarpIdCache::DlarpIdCache (uint32_t capacity, Time lifetime) :
+  m_ring (capacity),
+  m_next (0),
+  m_size (0),
+  m_lifetime (lifetime)
+{
+  NS_ASSERT (capacity > 0);
+}
+
+DlarpIdCache::Entry *
+DlarpIdCache::Lookup (Ipv4Address origin, uint32_t id)
+{
+  Time now = Simulator::Now ();
+  uint32_t capacity = m_ring.size ();
+  uint32_t i = m_next;
+  for (uint32_t n = 0; n < m_size; ++n)
+    {
+      i = (i == 0) ? capacity - 1 : i - 1;
+      Entry &entry = m_ring[i];
+      if (entry.expire <= now)
+        {
+          // Every older entry has expired too
+          return 0;
+        }
+      if (entry.id == id && entry.origin == origin)
+        {
+          return &entry;
+        }
+    }
+  return 0;
+}
+
+DlarpIdCache::Entry *
+DlarpIdCache::Insert (Ipv4Address origin, uint32_t id)
+{
+  Entry &entry = m_ring[m_next];
+  entry.origin = origin;
+  entry.id = id;
+  entry.expire = Simulator::Now () + m_lifetime;
+  entry.count = 1;
+  entry.rebroadcast = EventId ();
+  m_next = (m_next + 1) % m_ring.size ();
+  if (m_size < m_ring.size ())
+    {
+      m_size++;
+    }
+  return &entry;
+}
+
+bool
+DlarpIdCache::IsFull () const
+{
+  return m_size == m_ring.size () && m_ring[m_next].expire > Simulator::Now ();
+}
+
+void
+DlarpIdCache::SetCapacity (uint32_t capacity)
+{
+  NS_ASSERT (capacity > 0);
+  m_ring.assign (capacity, Entry ());
+  m_next = 0;
+  m_size = 0;
+}
+
+uint32_t
+DlarpIdCache::GetCapacity () const
+{
+  return m_ring.size ();
+}
+
+void
+DlarpIdCache::SetLifetime (Time lifetime)
+{
+  m_lifetime = lifetime;
+}
+
+Time
+DlarpIdCache::GetLifetime () const
+{
+  return m_lifetime;
+}
+
+} // namespace ns3
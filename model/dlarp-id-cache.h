@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_ID_CACHE_H
+#define DLARP_ID_CACHE_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Cache of recently seen (originator, request ID) pairs.
+ *
+ * Entries live in a fixed-size ring buffer: memory stays bounded however
+ * many RREQs are flooded, and a full ring overwrites its oldest entry.
+ * All the entries share the same lifetime, so the ring is ordered by
+ * expiry and a lookup scans from the newest entry and stops at the first
+ * expired one: its cost grows with the number of live entries.
+ *
+ * Overwriting a live entry forgets a request before its lifetime, and a
+ * late copy of it is then flooded again.  The capacity should therefore
+ * hold every distinct RREQ a node may hear within one lifetime, that is
+ * at least the RREQ rate of the whole network times the lifetime; IsFull
+ * tells the owner when it is too small.
+ */
+class DlarpIdCache
+{
+public:
+  /// A request seen recently
+  struct Entry
+  {
+    Ipv4Address origin;    //!< RREQ originator
+    uint32_t id;           //!< RREQ ID
+    Time expire;           //!< Expiration time
+    uint32_t count;        //!< Number of copies received
+    EventId rebroadcast;   //!< Pending rebroadcast of the request
+  };
+
+  /**
+   * \brief Constructor
+   * \param capacity number of entries of the ring
+   * \param lifetime lifetime of an entry
+   */
+  DlarpIdCache (uint32_t capacity, Time lifetime);
+
+  /**
+   * \param origin the RREQ originator
+   * \param id the RREQ ID
+   * \return the live entry of the request, or 0 if it was not seen recently
+   */
+  Entry * Lookup (Ipv4Address origin, uint32_t id);
+  /**
+   * \brief Record a request not seen recently, with a count of one
+   * \param origin the RREQ originator
+   * \param id the RREQ ID
+   * \return the new entry, valid until the next insertion
+   */
+  Entry * Insert (Ipv4Address origin, uint32_t id);
+  /// \return true if the next insertion overwrites an entry still alive
+  bool IsFull () const;
+
+  /**
+   * \brief Resize the ring, dropping every entry
+   * \param capacity number of entries
+   */
+  void SetCapacity (uint32_t capacity);
+  /// \return the number of entries of the ring
+  uint32_t GetCapacity () const;
+  /**
+   * \brief Set the lifetime of the entries inserted from now on
+   *
+   * Shortening it while entries are alive breaks the expiry order of the
+   * ring: a lookup may stop at a new entry that has expired before older
+   * ones, and miss them, until the older entries have expired.
+   *
+   * \param lifetime the lifetime
+   */
+  void SetLifetime (Time lifetime);
+  /// \return the lifetime of an entry
+  Time GetLifetime () const;
+
+private:
+  std::vector<Entry> m_ring;    //!< Entries, oldest overwritten first
+  uint32_t m_next;              //!< Index of the next entry to write
+  uint32_t m_size;              //!< Number of entries written, up to the capacity
+  Time m_lifetime;              //!< Lifetime of an entry
+};
+
+} // namespace ns3
+
+#endif /* DLARP_ID_CACHE_H */
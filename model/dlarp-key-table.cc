@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-key-table.h"
+#include <algorithm>
+
+namespace ns3 {
+
+/**
+ * \brief Final mix of a 64-bit hash (splitmix64)
+ * \param x the value
+ * \return the mixed value
+ */
+static uint64_t
+Mix64 (uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+DlarpKeyTable::DlarpKeyTable (uint64_t networkKey) :
+  m_networkKey (networkKey)
+{
+}
+
+uint64_t
+DlarpKeyTable::GetKey (Ipv4Address node)
+{
+  uint32_t address = node.Get ();
+  std::vector<Entry>::iterator it =
+    std::lower_bound (m_entries.begin (), m_entries.end (), address,
+                      [](const Entry &e, uint32_t a) {
+                        return e.node < a;
+                      });
+  if (it == m_entries.end () || it->node != address)
+    {
+      Entry entry;
+      entry.node = address;
+      entry.key = DeriveKey (node);
+      it = m_entries.insert (it, entry);
+    }
+  return it->key;
+}
+
+void
+DlarpKeyTable::Remove (Ipv4Address node)
+{
+  uint32_t address = node.Get ();
+  std::vector<Entry>::iterator it =
+    std::lower_bound (m_entries.begin (), m_entries.end (), address,
+                      [](const Entry &e, uint32_t a) {
+                        return e.node < a;
+                      });
+  if (it != m_entries.end () && it->node == address)
+    {
+      m_entries.erase (it);
+    }
+}
+
+void
+DlarpKeyTable::Clear ()
+{
+  m_entries.clear ();
+}
+
+uint32_t
+DlarpKeyTable::GetSize () const
+{
+  return m_entries.size ();
+}
+
+uint64_t
+DlarpKeyTable::DeriveKey (Ipv4Address node) const
+{
+  return Mix64 (m_networkKey ^ Mix64 (node.Get ()));
+}
+
+uint64_t
+DlarpKeyTable::ComputeMac (uint64_t key, const uint8_t *data, uint32_t size)
+{
+  // FNV-1a seeded with the key, then mixed with the key and the size
+  uint64_t hash = 14695981039346656037ull ^ key;
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ull;
+    }
+  return Mix64 (hash ^ Mix64 (key + size));
+}
+
+} // namespace ns3
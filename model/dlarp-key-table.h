@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_KEY_TABLE_H
+#define DLARP_KEY_TABLE_H
+
+#include "ns3/ipv4-address.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief MAC keys of the neighbors, for authenticated control messages.
+ *
+ * Every node signs the control messages it sends with its own key,
+ * derived from the network key and its address; its neighbors derive the
+ * same key on the first message they receive from it and cache it here.
+ * The table is a flat array sorted by address: a lookup is a binary
+ * search over contiguous entries, with no allocation once the
+ * neighborhood is known.
+ *
+ * The MAC is a keyed 64-bit hash standing in for a cryptographic MAC,
+ * truncated to the configured size: the simulation measures the size and
+ * processing cost of the tags, not their strength.
+ */
+class DlarpKeyTable
+{
+public:
+  /**
+   * \brief Constructor
+   * \param networkKey the key all node keys are derived from
+   */
+  DlarpKeyTable (uint64_t networkKey = 0x6a09e667f3bcc908ull);
+
+  /**
+   * \param node a node address
+   * \return its key, derived and cached on first use
+   */
+  uint64_t GetKey (Ipv4Address node);
+  /**
+   * \brief Forget the key of a node, typically a lost neighbor
+   * \param node the node address
+   */
+  void Remove (Ipv4Address node);
+  /// \brief Forget every key
+  void Clear ();
+  /// \return the number of cached keys
+  uint32_t GetSize () const;
+
+  /**
+   * \brief Compute the MAC of a message
+   * \param key the key of the sender
+   * \param data the message
+   * \param size its size in bytes
+   * \return the 64-bit tag; the first bytes of its big-endian encoding
+   *         are the truncated MAC
+   */
+  static uint64_t ComputeMac (uint64_t key, const uint8_t *data, uint32_t size);
+
+private:
+  /// A cached key
+  struct Entry
+  {
+    uint32_t node;         //!< Node address, the sort key
+    uint64_t key;          //!< Its key
+  };
+
+  /**
+   * \param node a node address
+   * \return the key derived for it
+   */
+  uint64_t DeriveKey (Ipv4Address node) const;
+
+  std::vector<Entry> m_entries;  //!< Cached keys, sorted by address
+  uint64_t m_networkKey;         //!< Key all node keys are derived from
+};
+
+} // namespace ns3
+
+#endif /* DLARP_KEY_TABLE_H */
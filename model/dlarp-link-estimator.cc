@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-link-estimator.h"
+#include "ns3/assert.h"
+#include <algorithm>
+
+namespace ns3 {
+
+DlarpLinkEstimator::DlarpLinkEstimator (uint32_t window) :
+  m_received (0),
+  m_lastSeqNo (0),
+  m_span (0),
+  m_window (window),
+  m_forwardRatio (-1)
+{
+  NS_ASSERT (window > 0 && window <= MAX_WINDOW);
+}
+
+void
+DlarpLinkEstimator::RecvHello (uint32_t seqNo)
+{
+  if (m_span == 0)
+    {
+      m_received = 1;
+      m_lastSeqNo = seqNo;
+      m_span = 1;
+      return;
+    }
+  int32_t gap = int32_t (seqNo - m_lastSeqNo);
+  if (gap <= 0)
+    {
+      return;
+    }
+  // Slide the window: the skipped sequence numbers count as lost
+  m_received = (uint32_t (gap) >= MAX_WINDOW) ? 0 : (m_received << gap);
+  m_received |= 1;
+  m_lastSeqNo = seqNo;
+  m_span = std::min<uint64_t> (uint64_t (m_span) + gap, m_window);
+}
+
+void
+DlarpLinkEstimator::SetForwardRatio (double ratio)
+{
+  m_forwardRatio = std::min (std::max (ratio, 0.0), 1.0);
+}
+
+double
+DlarpLinkEstimator::GetReverseRatio () const
+{
+  if (m_span == 0)
+    {
+      return 1;
+    }
+  uint64_t mask = (m_window == MAX_WINDOW) ? ~uint64_t (0) : ((uint64_t (1) << m_window) - 1);
+  uint64_t bits = m_received & mask;
+  uint32_t received = 0;
+  for (; bits != 0; bits &= bits - 1)
+    {
+      received++;
+    }
+  return double (received) / m_span;
+}
+
+double
+DlarpLinkEstimator::GetForwardRatio () const
+{
+  return (m_forwardRatio < 0) ? GetReverseRatio () : m_forwardRatio;
+}
+
+double
+DlarpLinkEstimator::GetEtx () const
+{
+  double delivery = GetForwardRatio () * GetReverseRatio ();
+  if (delivery * MAX_ETX <= 1)
+    {
+      return MAX_ETX;
+    }
+  return 1 / delivery;
+}
+
+} // namespace ns3
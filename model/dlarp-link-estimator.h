@@ -0,0 +1,62 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_LINK_ESTIMATOR_H
+#define DLARP_LINK_ESTIMATOR_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief ETX estimator of the link with one neighbor.
+ *
+ * The reverse delivery ratio (neighbor to this node) is the fraction of
+ * the neighbor's last HELLO sequence numbers that were received, over a
+ * sliding window of at most 64 HELLOs kept as a bitmap.  The forward
+ * delivery ratio (this node to the neighbor) is the reverse ratio the
+ * neighbor reports in its own HELLOs.  The link metric is
+ * ETX = 1 / (forward ratio * reverse ratio).
+ */
+class DlarpLinkEstimator
+{
+public:
+  /// Largest window, in HELLOs
+  static const uint32_t MAX_WINDOW = 64;
+  /// ETX of a link with no delivery in the window
+  static const uint32_t MAX_ETX = 255;
+
+  /**
+   * \brief Constructor
+   * \param window number of HELLOs of the sliding window, at most MAX_WINDOW
+   */
+  DlarpLinkEstimator (uint32_t window = 10);
+
+  /**
+   * \brief Record a HELLO received from the neighbor
+   * \param seqNo its sequence number; older or duplicate ones are ignored
+   */
+  void RecvHello (uint32_t seqNo);
+  /**
+   * \brief Record the delivery ratio the neighbor reports for this node
+   * \param ratio the forward delivery ratio, between 0 and 1
+   */
+  void SetForwardRatio (double ratio);
+
+  /// \return the reverse delivery ratio, 1 until a HELLO is received
+  double GetReverseRatio () const;
+  /// \return the forward delivery ratio, the reverse one until reported
+  double GetForwardRatio () const;
+  /// \return the ETX of the link, between 1 and MAX_ETX
+  double GetEtx () const;
+
+private:
+  uint64_t m_received;     //!< Bit i set if HELLO m_lastSeqNo - i was received
+  uint32_t m_lastSeqNo;    //!< Last HELLO sequence number received
+  uint32_t m_span;         //!< HELLOs sent since the first one received, up to the window
+  uint32_t m_window;       //!< Window size, in HELLOs
+  double m_forwardRatio;   //!< Reported forward ratio, negative until reported
+};
+
+} // namespace ns3
+
+#endif /* DLARP_LINK_ESTIMATOR_H */
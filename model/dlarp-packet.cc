@@ -0,0 +1,441 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-packet.h"
+#include "ns3/address-utils.h"
+#include "ns3/log.h"
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DlarpHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (DlarpHeader);
+
+uint16_t
+DlarpEncodeMetric (double metric)
+{
+  double scaled = std::round (metric * DLARP_METRIC_SCALE);
+  if (scaled < 0)
+    {
+      scaled = 0;
+    }
+  return (scaled > 65535.0) ? 65535 : (uint16_t) scaled;
+}
+
+double
+DlarpDecodeMetric (uint16_t encoded)
+{
+  return encoded / DLARP_METRIC_SCALE;
+}
+
+/// Units per 1.0 of a delivery ratio on the wire
+static const double DLARP_RATIO_SCALE = 255.0;
+
+/**
+ * \brief Convert a delivery ratio to its wire encoding
+ * \param ratio the ratio
+ * \return the ratio rounded to 1/255 and clamped to [0, 1], in 1/255 units
+ */
+static uint8_t
+EncodeRatio (double ratio)
+{
+  double scaled = std::round (ratio * DLARP_RATIO_SCALE);
+  return (scaled < 0) ? 0 : (scaled > 255.0) ? 255 : (uint8_t) scaled;
+}
+
+DlarpHeader::DlarpHeader (DlarpPacketType type) :
+  m_type (type),
+  m_hopCount (0),
+  m_ttl (255),
+  m_metric (0),
+  m_seqNo (0),
+  m_requestId (0),
+  m_valid (true)
+{
+}
+
+TypeId
+DlarpHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DlarpHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Dlarp")
+    .AddConstructor<DlarpHeader> ();
+  return tid;
+}
+
+TypeId
+DlarpHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+DlarpHeader::GetSerializedSize (void) const
+{
+  switch (m_type)
+    {
+    case DLARPTYPE_HELLO:
+      return 6 + DLARP_HELLO_RECORD_SIZE * m_helloRecords.size ();
+    case DLARPTYPE_RREQ:
+      return 21;
+    case DLARPTYPE_RREP:
+      return 16;
+    case DLARPTYPE_AGREEMENT:
+      return DLARP_AGREEMENT_HEADER_SIZE + DLARP_AGREEMENT_RECORD_SIZE * m_records.size ();
+    case DLARPTYPE_AUTH1:
+      return DLARP_AUTH1_SIZE;
+    case DLARPTYPE_AUTH2:
+      return DLARP_AUTH2_SIZE;
+    case DLARPTYPE_AUTH3:
+      return DLARP_AUTH3_SIZE;
+    case DLARPTYPE_RERR:
+      return 9;
+    default:
+      NS_ASSERT_MSG (false, "Unknown DLARP packet type " << (uint32_t) m_type);
+      return 1;
+    }
+}
+
+void
+DlarpHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_type);
+  switch (m_type)
+    {
+    case DLARPTYPE_HELLO:
+      i.WriteHtonU32 (m_seqNo);
+      i.WriteU8 (m_helloRecords.size ());
+      for (std::vector<DlarpHelloRecord>::const_iterator r = m_helloRecords.begin (); r != m_helloRecords.end (); ++r)
+        {
+          WriteTo (i, r->neighbor);
+          i.WriteU8 (EncodeRatio (r->ratio));
+        }
+      break;
+    case DLARPTYPE_RREQ:
+      i.WriteU8 (m_hopCount);
+      i.WriteU8 (m_ttl);
+      i.WriteHtonU16 (m_metric);
+      i.WriteHtonU32 (m_requestId);
+      WriteTo (i, m_src);
+      i.WriteHtonU32 (m_seqNo);
+      WriteTo (i, m_dst);
+      break;
+    case DLARPTYPE_RREP:
+      i.WriteU8 (m_hopCount);
+      i.WriteHtonU16 (m_metric);
+      WriteTo (i, m_src);
+      WriteTo (i, m_dst);
+      i.WriteHtonU32 (m_seqNo);
+      break;
+    case DLARPTYPE_AGREEMENT:
+      i.WriteU8 (m_records.size ());
+      for (std::vector<DlarpAgreementRecord>::const_iterator r = m_records.begin (); r != m_records.end (); ++r)
+        {
+          WriteTo (i, r->dst);
+          WriteTo (i, r->nextHop);
+          i.WriteHtonU32 (r->seqNo);
+          i.WriteHtonU16 (DlarpEncodeMetric (r->metric));
+        }
+      break;
+    case DLARPTYPE_AUTH1:
+    case DLARPTYPE_AUTH2:
+    case DLARPTYPE_AUTH3:
+      i.WriteHtonU32 (m_seqNo);
+      i.WriteU8 (0, GetSerializedSize () - 5);
+      break;
+    case DLARPTYPE_RERR:
+      WriteTo (i, m_src);
+      WriteTo (i, m_dst);
+      break;
+    default:
+      break;
+    }
+}
+
+uint32_t
+DlarpHeader::Deserialize (Buffer::Iterator start)
+{
+  // Fields are read straight out of the packet buffer: no intermediate copy
+  Buffer::Iterator i = start;
+  m_type = i.ReadU8 ();
+  m_helloRecords.clear ();
+  m_records.clear ();
+  // Messages are bundled back to back: a datagram may end within one
+  if (m_type < DLARPTYPE_HELLO || m_type > DLARPTYPE_RERR
+      || i.GetRemainingSize () < GetSerializedSize () - 1)
+    {
+      m_valid = false;
+      return i.GetDistanceFrom (start);
+    }
+  m_valid = true;
+  switch (m_type)
+    {
+    case DLARPTYPE_HELLO:
+      {
+        m_seqNo = i.ReadNtohU32 ();
+        uint32_t count = i.ReadU8 ();
+        m_helloRecords.clear ();
+        if (i.GetRemainingSize () < count * DLARP_HELLO_RECORD_SIZE)
+          {
+            m_valid = false;
+            break;
+          }
+        m_helloRecords.resize (count);
+        for (std::vector<DlarpHelloRecord>::iterator r = m_helloRecords.begin (); r != m_helloRecords.end (); ++r)
+          {
+            ReadFrom (i, r->neighbor);
+            r->ratio = i.ReadU8 () / DLARP_RATIO_SCALE;
+          }
+      }
+      break;
+    case DLARPTYPE_RREQ:
+      m_hopCount = i.ReadU8 ();
+      m_ttl = i.ReadU8 ();
+      m_metric = i.ReadNtohU16 ();
+      m_requestId = i.ReadNtohU32 ();
+      ReadFrom (i, m_src);
+      m_seqNo = i.ReadNtohU32 ();
+      ReadFrom (i, m_dst);
+      break;
+    case DLARPTYPE_RREP:
+      m_hopCount = i.ReadU8 ();
+      m_metric = i.ReadNtohU16 ();
+      ReadFrom (i, m_src);
+      ReadFrom (i, m_dst);
+      m_seqNo = i.ReadNtohU32 ();
+      break;
+    case DLARPTYPE_AGREEMENT:
+      {
+        uint32_t count = i.ReadU8 ();
+        m_records.clear ();
+        if (i.GetRemainingSize () < count * DLARP_AGREEMENT_RECORD_SIZE)
+          {
+            m_valid = false;
+            break;
+          }
+        m_records.resize (count);
+        for (std::vector<DlarpAgreementRecord>::iterator r = m_records.begin (); r != m_records.end (); ++r)
+          {
+            ReadFrom (i, r->dst);
+            ReadFrom (i, r->nextHop);
+            r->seqNo = i.ReadNtohU32 ();
+            r->metric = DlarpDecodeMetric (i.ReadNtohU16 ());
+          }
+      }
+      break;
+    case DLARPTYPE_AUTH1:
+    case DLARPTYPE_AUTH2:
+    case DLARPTYPE_AUTH3:
+      m_seqNo = i.ReadNtohU32 ();
+      i.Next (GetSerializedSize () - 5);
+      break;
+    case DLARPTYPE_RERR:
+      ReadFrom (i, m_src);
+      ReadFrom (i, m_dst);
+      break;
+    default:
+      m_valid = false;
+      break;
+    }
+  return i.GetDistanceFrom (start);
+}
+
+void
+DlarpHeader::Print (std::ostream &os) const
+{
+  switch (m_type)
+    {
+    case DLARPTYPE_HELLO:
+      os << "HELLO seqNo " << m_seqNo;
+      for (std::vector<DlarpHelloRecord>::const_iterator r = m_helloRecords.begin (); r != m_helloRecords.end (); ++r)
+        {
+          os << " (" << r->neighbor << " ratio " << r->ratio << ")";
+        }
+      break;
+    case DLARPTYPE_RREQ:
+      os << "RREQ id " << m_requestId << " src " << m_src << " seqNo " << m_seqNo
+         << " dst " << m_dst << " hopCount " << (uint32_t) m_hopCount
+         << " ttl " << (uint32_t) m_ttl << " metric " << GetMetric ();
+      break;
+    case DLARPTYPE_RREP:
+      os << "RREP src " << m_src << " dst " << m_dst << " seqNo " << m_seqNo
+         << " hopCount " << (uint32_t) m_hopCount << " metric " << GetMetric ();
+      break;
+    case DLARPTYPE_AGREEMENT:
+      os << "AGREEMENT";
+      for (std::vector<DlarpAgreementRecord>::const_iterator r = m_records.begin (); r != m_records.end (); ++r)
+        {
+          os << " (dst " << r->dst << " nextHop " << r->nextHop << " seqNo " << r->seqNo
+             << " metric " << r->metric << ")";
+        }
+      break;
+    case DLARPTYPE_AUTH1:
+    case DLARPTYPE_AUTH2:
+    case DLARPTYPE_AUTH3:
+      os << "AUTH" << (m_type - DLARPTYPE_AUTH1 + 1) << " seqNo " << m_seqNo;
+      break;
+    case DLARPTYPE_RERR:
+      os << "RERR src " << m_src << " dst " << m_dst;
+      break;
+    default:
+      os << "UNKNOWN_TYPE " << (uint32_t) m_type;
+      break;
+    }
+}
+
+bool
+DlarpHeader::IsValid (void) const
+{
+  return m_valid;
+}
+
+DlarpPacketType
+DlarpHeader::GetType (void) const
+{
+  return (DlarpPacketType) m_type;
+}
+
+uint32_t
+DlarpHeader::GetSeqNo (void) const
+{
+  return m_seqNo;
+}
+
+uint32_t
+DlarpHeader::GetRequestId (void) const
+{
+  return m_requestId;
+}
+
+Ipv4Address
+DlarpHeader::GetSrc (void) const
+{
+  return m_src;
+}
+
+Ipv4Address
+DlarpHeader::GetDst (void) const
+{
+  return m_dst;
+}
+
+uint8_t
+DlarpHeader::GetHopCount (void) const
+{
+  return m_hopCount;
+}
+
+uint8_t
+DlarpHeader::GetTtl (void) const
+{
+  return m_ttl;
+}
+
+double
+DlarpHeader::GetMetric (void) const
+{
+  return DlarpDecodeMetric (m_metric);
+}
+
+void
+DlarpHeader::SetType (DlarpPacketType type)
+{
+  m_type = type;
+  m_valid = true;
+}
+
+void
+DlarpHeader::SetSeqNo (uint32_t seqNo)
+{
+  m_seqNo = seqNo;
+}
+
+void
+DlarpHeader::SetRequestId (uint32_t requestId)
+{
+  m_requestId = requestId;
+}
+
+void
+DlarpHeader::SetSrc (Ipv4Address src)
+{
+  m_src = src;
+}
+
+void
+DlarpHeader::SetDst (Ipv4Address dst)
+{
+  m_dst = dst;
+}
+
+void
+DlarpHeader::SetHopCount (uint8_t hopCount)
+{
+  m_hopCount = hopCount;
+}
+
+void
+DlarpHeader::SetTtl (uint8_t ttl)
+{
+  m_ttl = ttl;
+}
+
+void
+DlarpHeader::SetMetric (double metric)
+{
+  m_metric = DlarpEncodeMetric (metric);
+}
+
+void
+DlarpHeader::AddHelloRecord (const DlarpHelloRecord &record)
+{
+  NS_ASSERT (m_helloRecords.size () < DLARP_MAX_HELLO_RECORDS);
+  DlarpHelloRecord rounded = record;
+  rounded.ratio = EncodeRatio (record.ratio) / DLARP_RATIO_SCALE;
+  m_helloRecords.push_back (rounded);
+}
+
+uint32_t
+DlarpHeader::GetNHelloRecords (void) const
+{
+  return m_helloRecords.size ();
+}
+
+const DlarpHelloRecord &
+DlarpHeader::GetHelloRecord (uint32_t i) const
+{
+  NS_ASSERT (i < m_helloRecords.size ());
+  return m_helloRecords[i];
+}
+
+void
+DlarpHeader::AddAgreementRecord (const DlarpAgreementRecord &record)
+{
+  NS_ASSERT (m_records.size () < DLARP_MAX_AGREEMENT_RECORDS);
+  DlarpAgreementRecord rounded = record;
+  rounded.metric = DlarpDecodeMetric (DlarpEncodeMetric (record.metric));
+  m_records.push_back (rounded);
+}
+
+uint32_t
+DlarpHeader::GetNAgreementRecords (void) const
+{
+  return m_records.size ();
+}
+
+const DlarpAgreementRecord &
+DlarpHeader::GetAgreementRecord (uint32_t i) const
+{
+  NS_ASSERT (i < m_records.size ());
+  return m_records[i];
+}
+
+void
+DlarpHeader::ClearAgreementRecords (void)
+{
+  m_records.clear ();
+}
+
+} // namespace ns3
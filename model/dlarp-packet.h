@@ -0,0 +1,228 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_PACKET_H
+#define DLARP_PACKET_H
+
+#include "ns3/header.h"
+#include "ns3/ipv4-address.h"
+#include <vector>
+
+namespace ns3 {
+
+// DLARP Packet Types
+enum DlarpPacketType
+{
+  DLARPTYPE_HELLO = 1,
+  DLARPTYPE_RREQ  = 2,
+  DLARPTYPE_RREP  = 3,
+  DLARPTYPE_AGREEMENT = 4,
+  DLARPTYPE_AUTH1 = 5,
+  DLARPTYPE_AUTH2 = 6,
+  DLARPTYPE_AUTH3 = 7,
+  DLARPTYPE_RERR  = 8
+};
+
+/// Maximum number of records of a HELLO message
+static const uint32_t DLARP_MAX_HELLO_RECORDS = 255;
+/// Size of one HELLO record on the wire
+static const uint32_t DLARP_HELLO_RECORD_SIZE = 5;
+/// Maximum number of records of an AGREEMENT message
+static const uint32_t DLARP_MAX_AGREEMENT_RECORDS = 255;
+/// Size of the fixed part of an AGREEMENT message, before its records
+static const uint32_t DLARP_AGREEMENT_HEADER_SIZE = 2;
+/// Size of one AGREEMENT record on the wire
+static const uint32_t DLARP_AGREEMENT_RECORD_SIZE = 14;
+/// Size of the first message (M1) of the authentication handshake
+static const uint32_t DLARP_AUTH1_SIZE = 104;
+/// Size of the second message (M2) of the authentication handshake
+static const uint32_t DLARP_AUTH2_SIZE = 84;
+/// Size of the third message (M3) of the authentication handshake
+static const uint32_t DLARP_AUTH3_SIZE = 84;
+/// Size of the IPv4 and UDP headers in front of every DLARP datagram
+static const uint32_t DLARP_UDP_IPV4_HEADER_SIZE = 28;
+/// Metric units per 1.0 in the 12.4 fixed-point encoding, on the wire and in the routing table
+static const double DLARP_METRIC_SCALE = 16.0;
+
+/**
+ * \brief Convert a metric to its 12.4 fixed-point encoding
+ * \param metric the metric
+ * \return the metric rounded to 1/16 and saturated at 4095.9375
+ */
+uint16_t DlarpEncodeMetric (double metric);
+/**
+ * \param encoded a metric in 12.4 fixed point
+ * \return the metric
+ */
+double DlarpDecodeMetric (uint16_t encoded);
+
+/// One neighbor reported by a HELLO message
+struct DlarpHelloRecord
+{
+  Ipv4Address neighbor;    //!< Neighbor of the sender
+  double ratio;            //!< Fraction of the neighbor's HELLOs the sender received
+};
+
+/// One destination advertised by an AGREEMENT message
+struct DlarpAgreementRecord
+{
+  Ipv4Address dst;         //!< Destination
+  Ipv4Address nextHop;     //!< Next hop of the sender's route to dst
+  uint32_t seqNo;          //!< Sequence number of the route
+  double metric;           //!< Metric of the sender's route to dst
+};
+
+/**
+ * \ingroup dlarp
+ * \brief DLARP message header.
+ *
+ * Every message starts with its type byte and has a fixed, unpadded
+ * layout for that type, all fields in network byte order.  Metrics travel
+ * as unsigned 12.4 fixed-point numbers.
+ *
+ \verbatim
+  HELLO (6 + 5 * count bytes)
+  +------+--------+-------+----------+-------+-----+
+  | type | seqNo  | count | neighbor | ratio | ... |
+  +------+--------+-------+----------+-------+-----+
+                          |<-- one record -->|
+
+  RREQ (21 bytes)
+  +------+----------+-----+--------+-----------+--------+--------+--------+
+  | type | hopCount | ttl | metric | requestId |  src   | seqNo  |  dst   |
+  +------+----------+-----+--------+-----------+--------+--------+--------+
+
+  RREP (16 bytes)
+  +------+----------+--------+--------+--------+--------+
+  | type | hopCount | metric |  src   |  dst   | seqNo  |
+  +------+----------+--------+--------+--------+--------+
+
+  AGREEMENT (2 + 14 * count bytes)
+  +------+-------+--------+---------+--------+--------+-----+
+  | type | count |  dst   | nextHop | seqNo  | metric | ... |
+  +------+-------+--------+---------+--------+--------+-----+
+                 |<---------- one record ---------->|
+
+  AUTH1 (104 bytes), AUTH2 (84 bytes), AUTH3 (84 bytes)
+  +------+--------+----------------------+
+  | type | seqNo  | cryptographic fields |
+  +------+--------+----------------------+
+
+  RERR (9 bytes)
+  +------+--------+--------+
+  | type |  src   |  dst   |
+  +------+--------+--------+
+ \endverbatim
+ *
+ * In a RREQ, src and seqNo identify the originator and its sequence
+ * number, and ttl the number of hops it may still travel; in a RREP, src is
+ * the originator the reply travels back to and seqNo is the sequence
+ * number of dst.  A RERR travels back to the source src of data that
+ * could not be forwarded to dst.  The sender of a HELLO is the
+ * source address of the datagram carrying it; its records give, for each
+ * neighbor, the fraction of that neighbor's HELLOs it received, in units
+ * of 1/255.  An AGREEMENT carries up to
+ * DLARP_MAX_AGREEMENT_RECORDS routes of its sender, one record each; the
+ * next hop a record names treats it as poisoned, which keeps two
+ * neighbors from routing through each other.
+ *
+ * AUTH1 to AUTH3 are the messages M1 to M3 of the handshake that
+ * authenticates two neighbors; seqNo identifies the handshake.  Only their
+ * sizes matter to the simulation: the cryptographic fields are sent as
+ * zeros and skipped on reception.
+ *
+ * A datagram carries one or more messages back to back, with no padding:
+ * each message is delimited by its own type and record count.
+ */
+class DlarpHeader : public Header
+{
+public:
+  /**
+   * \brief Constructor
+   * \param type the message type
+   */
+  DlarpHeader (DlarpPacketType type = DLARPTYPE_HELLO);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  TypeId GetInstanceTypeId (void) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+  void Print (std::ostream &os) const;
+
+  /**
+   * \return true if the last deserialized message had a known type and
+   *         was not truncated
+   */
+  bool IsValid (void) const;
+
+  // Getters and setters
+  DlarpPacketType GetType (void) const;
+  uint32_t GetSeqNo (void) const;
+  uint32_t GetRequestId (void) const;
+  Ipv4Address GetSrc (void) const;
+  Ipv4Address GetDst (void) const;
+  uint8_t GetHopCount (void) const;
+  uint8_t GetTtl (void) const;
+  double GetMetric (void) const;
+
+  void SetType (DlarpPacketType type);
+  void SetSeqNo (uint32_t seqNo);
+  void SetRequestId (uint32_t requestId);
+  void SetSrc (Ipv4Address src);
+  void SetDst (Ipv4Address dst);
+  void SetHopCount (uint8_t hopCount);
+  void SetTtl (uint8_t ttl);
+  /**
+   * \brief Set the metric, rounded to 1/16 and saturated at 4095.9375
+   * \param metric the route metric
+   */
+  void SetMetric (double metric);
+
+  /**
+   * \brief Append a record to a HELLO message
+   * \param record the record; its ratio is rounded to 1/255
+   */
+  void AddHelloRecord (const DlarpHelloRecord &record);
+  /// \return the number of records of a HELLO message
+  uint32_t GetNHelloRecords (void) const;
+  /**
+   * \param i the record index
+   * \return the record
+   */
+  const DlarpHelloRecord & GetHelloRecord (uint32_t i) const;
+
+  /**
+   * \brief Append a record to an AGREEMENT message
+   * \param record the record; its metric is rounded as by SetMetric
+   */
+  void AddAgreementRecord (const DlarpAgreementRecord &record);
+  /// \return the number of records of an AGREEMENT message
+  uint32_t GetNAgreementRecords (void) const;
+  /**
+   * \param i the record index
+   * \return the record
+   */
+  const DlarpAgreementRecord & GetAgreementRecord (uint32_t i) const;
+  /// \brief Remove every record of an AGREEMENT message
+  void ClearAgreementRecords (void);
+
+private:
+  uint8_t m_type;          //!< Packet type
+  uint8_t m_hopCount;      //!< Hop count
+  uint8_t m_ttl;           //!< Hops a RREQ may still travel
+  uint16_t m_metric;       //!< Route metric, 12.4 fixed-point
+  uint32_t m_seqNo;        //!< Sequence number
+  uint32_t m_requestId;    //!< Request ID for RREQ
+  Ipv4Address m_src;       //!< Source address
+  Ipv4Address m_dst;       //!< Destination address
+  std::vector<DlarpHelloRecord> m_helloRecords; //!< Records of a HELLO
+  std::vector<DlarpAgreementRecord> m_records; //!< Records of an AGREEMENT
+  bool m_valid;            //!< Whether the type is known and the message complete
+};
+
+} // namespace ns3
+
+#endif /* DLARP_PACKET_H */
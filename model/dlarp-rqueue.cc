@@ -0,0 +1,306 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-rqueue.h"
+#include "ns3/simulator.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+DlarpRequestQueue::DlarpRequestQueue (uint32_t maxPackets, uint32_t maxBytes, Time timeout, DropPolicy policy) :
+  m_maxBytes (maxBytes),
+  m_timeout (timeout),
+  m_policy (policy)
+{
+  SetMaxPackets (maxPackets);
+}
+
+bool
+DlarpRequestQueue::Enqueue (const Entry &entry, std::vector<Entry> &dropped)
+{
+  DropExpired (dropped);
+  
+  Time expire = entry.expire.IsZero () ? Simulator::Now () + m_timeout : entry.expire;
+  uint32_t size = entry.packet->GetSize ();
+  if (m_pool.empty () || size > m_maxBytes || expire <= Simulator::Now ())
+    {
+      dropped.push_back (entry);
+      return false;
+    }
+  while (m_size == m_pool.size () || m_bytes + size > m_maxBytes)
+    {
+      if (m_policy == DROP_TAIL)
+        {
+          dropped.push_back (entry);
+          return false;
+        }
+      DropOldest (dropped);
+    }
+  
+  uint32_t index = m_free;
+  Slot &slot = m_pool[index];
+  m_free = slot.nextInFifo;
+  slot.entry = entry;
+  slot.entry.expire = expire;
+  slot.nextInFifo = NONE;
+  
+  // Both lists stay in expiry order, ties in queueing order: only packets
+  // queued again or a shorter timeout put a packet before the newest ones
+  uint32_t older = m_newest;
+  while (older != NONE && expire < m_pool[older].entry.expire)
+    {
+      older = m_pool[older].older;
+    }
+  slot.older = older;
+  slot.newer = (older != NONE) ? m_pool[older].newer : m_oldest;
+  if (slot.newer != NONE)
+    {
+      m_pool[slot.newer].older = index;
+    }
+  else
+    {
+      m_newest = index;
+    }
+  if (older != NONE)
+    {
+      m_pool[older].newer = index;
+    }
+  else
+    {
+      m_oldest = index;
+    }
+  
+  Fifo &fifo = m_fifos[FindFifo (entry.header.GetDestination ())];
+  if (fifo.head == NONE)
+    {
+      fifo.dst = entry.header.GetDestination ();
+      fifo.head = index;
+      fifo.tail = index;
+    }
+  else if (!(expire < m_pool[fifo.tail].entry.expire))
+    {
+      m_pool[fifo.tail].nextInFifo = index;
+      fifo.tail = index;
+    }
+  else if (expire < m_pool[fifo.head].entry.expire)
+    {
+      slot.nextInFifo = fifo.head;
+      fifo.head = index;
+    }
+  else
+    {
+      uint32_t previous = fifo.head;
+      while (!(expire < m_pool[m_pool[previous].nextInFifo].entry.expire))
+        {
+          previous = m_pool[previous].nextInFifo;
+        }
+      slot.nextInFifo = m_pool[previous].nextInFifo;
+      m_pool[previous].nextInFifo = index;
+    }
+  m_size++;
+  m_bytes += size;
+  return true;
+}
+
+void
+DlarpRequestQueue::Dequeue (Ipv4Address dst, std::vector<Entry> &entries, std::vector<Entry> &dropped)
+{
+  uint32_t bucket = FindFifo (dst);
+  if (m_fifos[bucket].head == NONE)
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  uint32_t index = m_fifos[bucket].head;
+  while (index != NONE)
+    {
+      uint32_t next = m_pool[index].nextInFifo;
+      if (m_pool[index].entry.expire <= now)
+        {
+          dropped.push_back (m_pool[index].entry);
+        }
+      else
+        {
+          entries.push_back (m_pool[index].entry);
+        }
+      Release (index);
+      index = next;
+    }
+  EraseFifo (bucket);
+}
+
+void
+DlarpRequestQueue::DropExpired (std::vector<Entry> &dropped)
+{
+  Time now = Simulator::Now ();
+  while (m_oldest != NONE && m_pool[m_oldest].entry.expire <= now)
+    {
+      DropOldest (dropped);
+    }
+}
+
+bool
+DlarpRequestQueue::Find (Ipv4Address dst) const
+{
+  return m_fifos[FindFifo (dst)].head != NONE;
+}
+
+void
+DlarpRequestQueue::DropOldest (std::vector<Entry> &dropped)
+{
+  uint32_t index = m_oldest;
+  NS_ASSERT (index != NONE);
+  // The oldest entry of the buffer is the head of its destination FIFO
+  uint32_t bucket = FindFifo (m_pool[index].entry.header.GetDestination ());
+  NS_ASSERT (m_fifos[bucket].head == index);
+  m_fifos[bucket].head = m_pool[index].nextInFifo;
+  if (m_fifos[bucket].head == NONE)
+    {
+      EraseFifo (bucket);
+    }
+  dropped.push_back (m_pool[index].entry);
+  Release (index);
+}
+
+void
+DlarpRequestQueue::Release (uint32_t index)
+{
+  Slot &slot = m_pool[index];
+  if (slot.older != NONE)
+    {
+      m_pool[slot.older].newer = slot.newer;
+    }
+  else
+    {
+      m_oldest = slot.newer;
+    }
+  if (slot.newer != NONE)
+    {
+      m_pool[slot.newer].older = slot.older;
+    }
+  else
+    {
+      m_newest = slot.older;
+    }
+  m_size--;
+  m_bytes -= slot.entry.packet->GetSize ();
+  // Let go of the packet and of the callbacks now, not when the slot is reused
+  slot.entry = Entry ();
+  slot.nextInFifo = m_free;
+  m_free = index;
+}
+
+uint32_t
+DlarpRequestQueue::FindFifo (Ipv4Address dst) const
+{
+  // Fibonacci hashing and linear probing, as in the routing table
+  uint32_t mask = m_fifos.size () - 1;
+  uint32_t i = (dst.Get () * 2654435769u) >> m_shift;
+  while (m_fifos[i].head != NONE && !(m_fifos[i].dst == dst))
+    {
+      i = (i + 1) & mask;
+    }
+  return i;
+}
+
+void
+DlarpRequestQueue::EraseFifo (uint32_t index)
+{
+  uint32_t mask = m_fifos.size () - 1;
+  uint32_t hole = index;
+  uint32_t i = (hole + 1) & mask;
+  while (m_fifos[i].head != NONE)
+    {
+      // Move bucket i into the hole unless its home lies cyclically in (hole, i]
+      uint32_t home = (m_fifos[i].dst.Get () * 2654435769u) >> m_shift;
+      if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+          m_fifos[hole] = m_fifos[i];
+          hole = i;
+        }
+      i = (i + 1) & mask;
+    }
+  m_fifos[hole].head = NONE;
+}
+
+uint32_t
+DlarpRequestQueue::GetSize () const
+{
+  return m_size;
+}
+
+uint32_t
+DlarpRequestQueue::GetBytes () const
+{
+  return m_bytes;
+}
+
+void
+DlarpRequestQueue::SetMaxPackets (uint32_t maxPackets)
+{
+  m_pool.assign (maxPackets, Slot ());
+  for (uint32_t i = 0; i < maxPackets; ++i)
+    {
+      m_pool[i].nextInFifo = (i + 1 < maxPackets) ? i + 1 : NONE;
+    }
+  m_free = maxPackets > 0 ? 0 : NONE;
+  // At most one destination per packet: the index stays at most half full
+  uint32_t buckets = 2;
+  m_shift = 31;
+  while (buckets < 2 * maxPackets)
+    {
+      buckets *= 2;
+      m_shift--;
+    }
+  Fifo empty;
+  empty.head = NONE;
+  empty.tail = NONE;
+  m_fifos.assign (buckets, empty);
+  m_oldest = NONE;
+  m_newest = NONE;
+  m_size = 0;
+  m_bytes = 0;
+}
+
+uint32_t
+DlarpRequestQueue::GetMaxPackets () const
+{
+  return m_pool.size ();
+}
+
+void
+DlarpRequestQueue::SetMaxBytes (uint32_t maxBytes)
+{
+  m_maxBytes = maxBytes;
+}
+
+uint32_t
+DlarpRequestQueue::GetMaxBytes () const
+{
+  return m_maxBytes;
+}
+
+void
+DlarpRequestQueue::SetTimeout (Time timeout)
+{
+  m_timeout = timeout;
+}
+
+Time
+DlarpRequestQueue::GetTimeout () const
+{
+  return m_timeout;
+}
+
+void
+DlarpRequestQueue::SetDropPolicy (DropPolicy policy)
+{
+  m_policy = policy;
+}
+
+DlarpRequestQueue::DropPolicy
+DlarpRequestQueue::GetDropPolicy () const
+{
+  return m_policy;
+}
+
+} // namespace ns3
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_RQUEUE_H
+#define DLARP_RQUEUE_H
+
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Packets waiting for a route discovery to complete.
+ *
+ * The buffer is bounded both in packets and in bytes.  Its entries live in
+ * a pool allocated once for the maximum number of packets and are chained
+ * by index: one FIFO per destination, plus one list of all the entries in
+ * expiry order used for the drop-oldest policy and for expiry.  The FIFOs
+ * are found through an open-addressing index sized for one destination
+ * per packet, also allocated once.  Queueing and dropping a packet
+ * therefore never allocate.
+ *
+ * A packet queued again, after a route was found but could not be used
+ * yet, keeps its expiry: it waits at most the timeout in all.
+ *
+ * The buffer does not invoke any callback: the entries it drops are handed
+ * back to the caller, which reports them.
+ */
+class DlarpRequestQueue
+{
+public:
+  /// What to drop when a packet does not fit
+  enum DropPolicy
+  {
+    DROP_TAIL = 0,     //!< Drop the arriving packet
+    DROP_OLDEST = 1    //!< Drop the oldest packets of the buffer
+  };
+
+  /// A packet waiting for a route
+  struct Entry
+  {
+    Ptr<const Packet> packet;                              //!< The packet
+    Ipv4Header header;                                     //!< Its IPv4 header
+    Ipv4RoutingProtocol::UnicastForwardCallback ucb;       //!< Forwarding callback
+    Ipv4RoutingProtocol::ErrorCallback ecb;                //!< Error callback
+    Time expire;                                           //!< When it is dropped
+  };
+
+  /**
+   * \brief Constructor
+   * \param maxPackets maximum number of packets
+   * \param maxBytes maximum number of bytes
+   * \param timeout how long a packet may wait
+   * \param policy the drop policy
+   */
+  DlarpRequestQueue (uint32_t maxPackets, uint32_t maxBytes, Time timeout, DropPolicy policy);
+
+  /**
+   * \brief Queue a packet, first dropping the expired ones
+   * \param entry the packet; its expiry is set here unless it has one,
+   *        as packets queued again do
+   * \param dropped receives the packets dropped, possibly including this one
+   * \return true if the packet was queued
+   */
+  bool Enqueue (const Entry &entry, std::vector<Entry> &dropped);
+  /**
+   * \brief Remove every packet towards dst, oldest first
+   * \param dst the destination
+   * \param entries receives the packets still valid
+   * \param dropped receives the expired packets
+   */
+  void Dequeue (Ipv4Address dst, std::vector<Entry> &entries, std::vector<Entry> &dropped);
+  /**
+   * \brief Remove the expired packets
+   *
+   * Enqueue and Dequeue call it; the owner also calls it periodically, so
+   * that an idle buffer does not hold packets past their expiry.
+   *
+   * \param dropped receives them
+   */
+  void DropExpired (std::vector<Entry> &dropped);
+  /**
+   * \param dst the destination
+   * \return true if a packet towards dst is queued
+   */
+  bool Find (Ipv4Address dst) const;
+
+  /// \return the number of packets queued
+  uint32_t GetSize () const;
+  /// \return the number of bytes queued
+  uint32_t GetBytes () const;
+  /**
+   * \brief Reallocate the pool, dropping every packet
+   * \param maxPackets maximum number of packets
+   */
+  void SetMaxPackets (uint32_t maxPackets);
+  /// \return the maximum number of packets
+  uint32_t GetMaxPackets () const;
+  /**
+   * \param maxBytes maximum number of bytes, for the packets queued from now on
+   */
+  void SetMaxBytes (uint32_t maxBytes);
+  /// \return the maximum number of bytes
+  uint32_t GetMaxBytes () const;
+  /**
+   * \param timeout how long the packets queued from now on may wait
+   */
+  void SetTimeout (Time timeout);
+  /// \return how long a packet may wait
+  Time GetTimeout () const;
+  /**
+   * \param policy the drop policy
+   */
+  void SetDropPolicy (DropPolicy policy);
+  /// \return the drop policy
+  DropPolicy GetDropPolicy () const;
+
+private:
+  /// No entry
+  static const uint32_t NONE = 0xffffffff;
+
+  /// Pool slot
+  struct Slot
+  {
+    Entry entry;           //!< The packet, if the slot is in use
+    uint32_t nextInFifo;   //!< Next entry of the destination FIFO, or of the free list
+    uint32_t older;        //!< Previous entry in expiry order
+    uint32_t newer;        //!< Next entry in expiry order
+  };
+
+  /// FIFO of one destination, a bucket of the FIFO index
+  struct Fifo
+  {
+    Ipv4Address dst;       //!< Destination
+    uint32_t head;         //!< Oldest entry, NONE for an empty bucket
+    uint32_t tail;         //!< Newest entry
+  };
+
+  /**
+   * \brief Drop the oldest entry of the buffer
+   * \param dropped receives it
+   */
+  void DropOldest (std::vector<Entry> &dropped);
+  /**
+   * \brief Unlink a slot from the arrival-order list and free it
+   * \param index the slot
+   */
+  void Release (uint32_t index);
+  /**
+   * \param dst a destination
+   * \return the bucket of its FIFO, or the empty bucket where it would go
+   */
+  uint32_t FindFifo (Ipv4Address dst) const;
+  /**
+   * \brief Empty a bucket of the FIFO index, shifting back the buckets
+   * that probed past it
+   * \param index the bucket
+   */
+  void EraseFifo (uint32_t index);
+
+  std::vector<Slot> m_pool;                //!< Preallocated entries
+  std::vector<Fifo> m_fifos;               //!< Index of the FIFOs, by destination
+  uint32_t m_shift;                        //!< 32 - log2 of the index size
+  uint32_t m_free;                         //!< First free slot
+  uint32_t m_oldest;                       //!< Oldest entry
+  uint32_t m_newest;                       //!< Newest entry
+  uint32_t m_size;                         //!< Number of packets queued
+  uint32_t m_bytes;                        //!< Number of bytes queued
+  uint32_t m_maxBytes;                     //!< Maximum number of bytes
+  Time m_timeout;                          //!< How long a packet may wait
+  DropPolicy m_policy;                     //!< Drop policy
+};
+
+} // namespace ns3
+
+#endif /* DLARP_RQUEUE_H */
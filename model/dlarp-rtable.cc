@@ -0,0 +1,693 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-rtable.h"
+#include "dlarp-packet.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DlarpRoutingTable");
+
+// RoutingTableEntry implementation
+
+/**
+ * \brief Convert an absolute lifetime to its stored form
+ * \param lifeTime the expiration time
+ * \return it in milliseconds, rounded up and saturated
+ */
+static uint32_t
+EncodeLifeTime (Time lifeTime)
+{
+  int64_t ms = (lifeTime.GetNanoSeconds () + 999999) / 1000000;
+  if (ms < 0)
+    {
+      return 0;
+    }
+  return std::min<int64_t> (ms, std::numeric_limits<uint32_t>::max ());
+}
+
+DlarpRoutingTableEntry::DlarpRoutingTableEntry () :
+  m_seqNo (0),
+  m_lifeTime (0),
+  m_lastUsed (0),
+  m_metric (0),
+  m_interface (0)
+{
+}
+
+DlarpRoutingTableEntry::DlarpRoutingTableEntry (Ipv4Address dst, Ipv4Address nextHop, uint32_t interface, uint32_t seqNo) :
+  m_destination (dst),
+  m_nextHop (nextHop),
+  m_seqNo (seqNo),
+  m_lifeTime (EncodeLifeTime (Simulator::Now ())),
+  m_lastUsed (0),
+  m_metric (0),
+  m_interface (interface)
+{
+  NS_ASSERT_MSG (interface <= std::numeric_limits<uint16_t>::max (), "Interface index " << interface << " out of range");
+}
+
+Ipv4Address
+DlarpRoutingTableEntry::GetDestination () const
+{
+  return m_destination;
+}
+
+Ipv4Address
+DlarpRoutingTableEntry::GetNextHop () const
+{
+  return m_nextHop;
+}
+
+uint32_t
+DlarpRoutingTableEntry::GetInterface () const
+{
+  return m_interface;
+}
+
+uint32_t
+DlarpRoutingTableEntry::GetSeqNo () const
+{
+  return m_seqNo;
+}
+
+Time
+DlarpRoutingTableEntry::GetLifeTime () const
+{
+  return MilliSeconds (m_lifeTime);
+}
+
+double
+DlarpRoutingTableEntry::GetMetric () const
+{
+  return DlarpDecodeMetric (m_metric);
+}
+
+Ptr<Ipv4Route>
+DlarpRoutingTableEntry::GetRoute () const
+{
+  return m_route;
+}
+
+Time
+DlarpRoutingTableEntry::GetLastUsed () const
+{
+  return MilliSeconds (m_lastUsed);
+}
+
+void
+DlarpRoutingTableEntry::SetLifeTime (Time lifeTime)
+{
+  m_lifeTime = EncodeLifeTime (lifeTime);
+}
+
+void
+DlarpRoutingTableEntry::SetMetric (double metric)
+{
+  m_metric = DlarpEncodeMetric (metric);
+}
+
+void
+DlarpRoutingTableEntry::SetNextHop (Ipv4Address nextHop)
+{
+  m_nextHop = nextHop;
+}
+
+void
+DlarpRoutingTableEntry::SetInterface (uint32_t interface)
+{
+  NS_ASSERT_MSG (interface <= std::numeric_limits<uint16_t>::max (), "Interface index " << interface << " out of range");
+  m_interface = interface;
+}
+
+void
+DlarpRoutingTableEntry::SetSeqNo (uint32_t seqNo)
+{
+  m_seqNo = seqNo;
+}
+
+void
+DlarpRoutingTableEntry::SetRoute (Ptr<Ipv4Route> route)
+{
+  m_route = route;
+}
+
+void
+DlarpRoutingTableEntry::SetLastUsed (Time lastUsed)
+{
+  m_lastUsed = EncodeLifeTime (lastUsed);
+}
+
+// RoutingTable implementation
+
+/// Initial number of buckets, a power of two
+static const uint32_t DLARP_RTABLE_MIN_SLOTS = 16;
+
+DlarpRoutingTable::Slot::Slot () :
+  best (-1),
+  used (false)
+{
+}
+
+DlarpRoutingTable::DlarpRoutingTable () :
+  m_slots (DLARP_RTABLE_MIN_SLOTS),
+  m_shift (32 - 4),
+  m_size (0),
+  m_maxCandidates (0)
+{
+}
+
+void
+DlarpRoutingTable::SetMaxCandidates (uint32_t maxCandidates)
+{
+  m_maxCandidates = maxCandidates;
+  for (std::vector<Slot>::iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      if (i->used)
+        {
+          TrimSlot (*i);
+        }
+    }
+}
+
+uint32_t
+DlarpRoutingTable::GetMaxCandidates () const
+{
+  return m_maxCandidates;
+}
+
+uint32_t
+DlarpRoutingTable::Hash (Ipv4Address dst) const
+{
+  // Fibonacci hashing: addresses of one subnet differ in their low bits only
+  return (dst.Get () * 2654435769u) >> m_shift;
+}
+
+uint32_t
+DlarpRoutingTable::Find (Ipv4Address dst) const
+{
+  uint32_t mask = m_slots.size () - 1;
+  uint32_t i = Hash (dst);
+  while (m_slots[i].used && !(m_slots[i].dst == dst))
+    {
+      i = (i + 1) & mask;
+    }
+  return i;
+}
+
+bool
+DlarpRoutingTable::UpdateBest (Slot &slot)
+{
+  int32_t best = -1;
+  for (uint32_t i = 0; i < slot.candidates.size (); ++i)
+    {
+      if (best < 0 || slot.candidates[i].GetMetric () < slot.candidates[best].GetMetric ())
+        {
+          best = i;
+        }
+    }
+  bool changed = (best != slot.best);
+  slot.best = best;
+  return changed;
+}
+
+uint32_t
+DlarpRoutingTable::Worst (const Slot &slot) const
+{
+  Time now = Simulator::Now ();
+  uint32_t worst = 0;
+  for (uint32_t i = 0; i < slot.candidates.size (); ++i)
+    {
+      if (slot.candidates[i].GetLifeTime () <= now)
+        {
+          return i;
+        }
+      if (slot.candidates[i].GetMetric () > slot.candidates[worst].GetMetric ())
+        {
+          worst = i;
+        }
+    }
+  return worst;
+}
+
+void
+DlarpRoutingTable::TrimSlot (Slot &slot)
+{
+  if (m_maxCandidates == 0 || slot.candidates.size () <= m_maxCandidates)
+    {
+      return;
+    }
+  while (slot.candidates.size () > m_maxCandidates)
+    {
+      slot.candidates.erase (slot.candidates.begin () + Worst (slot));
+    }
+  slot.candidates.shrink_to_fit ();
+  UpdateBest (slot);
+}
+
+bool
+DlarpRoutingTable::PurgeSlot (Slot &slot)
+{
+  Time now = Simulator::Now ();
+  std::vector<DlarpRoutingTableEntry>::iterator end =
+    std::remove_if (slot.candidates.begin (), slot.candidates.end (),
+                    [now](const DlarpRoutingTableEntry &e) {
+                      return e.GetLifeTime () <= now;
+                    });
+  if (end == slot.candidates.end ())
+    {
+      return false;
+    }
+  slot.candidates.erase (end, slot.candidates.end ());
+  UpdateBest (slot);
+  return true;
+}
+
+void
+DlarpRoutingTable::Erase (uint32_t index)
+{
+  uint32_t mask = m_slots.size () - 1;
+  uint32_t hole = index;
+  uint32_t i = (hole + 1) & mask;
+  while (m_slots[i].used)
+    {
+      // Move bucket i into the hole unless its home lies cyclically in (hole, i]
+      uint32_t home = Hash (m_slots[i].dst);
+      if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+          std::swap (m_slots[hole], m_slots[i]);
+          hole = i;
+        }
+      i = (i + 1) & mask;
+    }
+  m_slots[hole].used = false;
+  m_slots[hole].best = -1;
+  // Release the array: a freed bucket may stay empty for long
+  std::vector<DlarpRoutingTableEntry> ().swap (m_slots[hole].candidates);
+  m_size--;
+}
+
+void
+DlarpRoutingTable::Grow ()
+{
+  std::vector<Slot> old;
+  old.swap (m_slots);
+  m_slots.resize (old.size () * 2);
+  m_shift--;
+  for (std::vector<Slot>::iterator i = old.begin (); i != old.end (); ++i)
+    {
+      if (i->used)
+        {
+          std::swap (m_slots[Find (i->dst)], *i);
+        }
+    }
+}
+
+bool
+DlarpRoutingTable::AddRoute (const DlarpRoutingTableEntry &entry)
+{
+  NS_LOG_FUNCTION (this << entry.GetDestination () << entry.GetNextHop ());
+  // Keep the load factor below 3/4
+  if (4 * (m_size + 1) > 3 * m_slots.size ())
+    {
+      Grow ();
+    }
+  uint32_t i = Find (entry.GetDestination ());
+  Slot &slot = m_slots[i];
+  if (!slot.used)
+    {
+      slot.used = true;
+      slot.dst = entry.GetDestination ();
+      m_size++;
+    }
+  for (std::vector<DlarpRoutingTableEntry>::iterator j = slot.candidates.begin ();
+       j != slot.candidates.end (); ++j)
+    {
+      if (j->GetNextHop () == entry.GetNextHop ())
+        {
+          bool metricChanged = (j->GetMetric () != entry.GetMetric ());
+          Ptr<Ipv4Route> route = j->GetRoute ();
+          bool sameInterface = (j->GetInterface () == entry.GetInterface ());
+          Time lastUsed = Max (j->GetLastUsed (), entry.GetLastUsed ());
+          *j = entry;
+          j->SetLastUsed (lastUsed);
+          if (sameInterface && entry.GetRoute () == 0)
+            {
+              // A refresh through the same hop keeps its cached route
+              j->SetRoute (route);
+            }
+          return metricChanged && UpdateBest (slot);
+        }
+    }
+  if (m_maxCandidates > 0 && slot.candidates.size () >= m_maxCandidates)
+    {
+      // Evict in place rather than grow the array
+      DlarpRoutingTableEntry &worst = slot.candidates[Worst (slot)];
+      if (worst.GetLifeTime () > Simulator::Now () && worst.GetMetric () <= entry.GetMetric ())
+        {
+          NS_LOG_LOGIC ("Candidate cap reached towards " << entry.GetDestination ()
+                        << ", ignoring next hop " << entry.GetNextHop ());
+          return false;
+        }
+      worst = entry;
+      return UpdateBest (slot);
+    }
+  slot.candidates.push_back (entry);
+  return UpdateBest (slot);
+}
+
+bool
+DlarpRoutingTable::SetMetric (Ipv4Address dst, Ipv4Address nextHop, double metric)
+{
+  Slot &slot = m_slots[Find (dst)];
+  if (!slot.used)
+    {
+      return false;
+    }
+  for (std::vector<DlarpRoutingTableEntry>::iterator j = slot.candidates.begin ();
+       j != slot.candidates.end (); ++j)
+    {
+      if (j->GetNextHop () == nextHop)
+        {
+          double old = j->GetMetric ();
+          j->SetMetric (metric);
+          // Changes below the stored resolution leave the best route as is
+          return j->GetMetric () != old && UpdateBest (slot);
+        }
+    }
+  return false;
+}
+
+bool
+DlarpRoutingTable::DeleteRoute (Ipv4Address dst, Ipv4Address nextHop)
+{
+  uint32_t i = Find (dst);
+  Slot &slot = m_slots[i];
+  if (!slot.used)
+    {
+      return false;
+    }
+  for (std::vector<DlarpRoutingTableEntry>::iterator j = slot.candidates.begin ();
+       j != slot.candidates.end (); ++j)
+    {
+      if (j->GetNextHop () == nextHop)
+        {
+          slot.candidates.erase (j);
+          if (slot.candidates.empty ())
+            {
+              Erase (i);
+            }
+          else
+            {
+              UpdateBest (slot);
+            }
+          return true;
+        }
+    }
+  return false;
+}
+
+bool
+DlarpRoutingTable::DeleteRoutes (Ipv4Address dst)
+{
+  uint32_t i = Find (dst);
+  if (!m_slots[i].used)
+    {
+      return false;
+    }
+  Erase (i);
+  return true;
+}
+
+DlarpRoutingTableEntry *
+DlarpRoutingTable::LookupRoute (Ipv4Address dst)
+{
+  uint32_t i = Find (dst);
+  Slot &slot = m_slots[i];
+  if (!slot.used)
+    {
+      return 0;
+    }
+  if (slot.best >= 0 && slot.candidates[slot.best].GetLifeTime () > Simulator::Now ())
+    {
+      return &slot.candidates[slot.best];
+    }
+  // The best candidate has expired: drop the stale ones and elect another
+  PurgeSlot (slot);
+  if (slot.candidates.empty ())
+    {
+      Erase (i);
+      return 0;
+    }
+  return &slot.candidates[slot.best];
+}
+
+DlarpRoutingTableEntry *
+DlarpRoutingTable::LookupRoute (Ipv4Address dst, uint32_t flowHash)
+{
+  Slot &slot = m_slots[Find (dst)];
+  if (!slot.used || slot.candidates.size () == 1)
+    {
+      return LookupRoute (dst);
+    }
+  Time now = Simulator::Now ();
+  DlarpRoutingTableEntry *chosen = 0;
+  double bestScore = 0;
+  for (std::vector<DlarpRoutingTableEntry>::iterator j = slot.candidates.begin ();
+       j != slot.candidates.end (); ++j)
+    {
+      if (j->GetLifeTime () <= now)
+        {
+          continue;
+        }
+      // Mix flow and next hop (murmur3 finalizer), then map to (0, 1)
+      uint32_t h = flowHash ^ j->GetNextHop ().Get ();
+      h ^= h >> 16;
+      h *= 0x85ebca6bu;
+      h ^= h >> 13;
+      h *= 0xc2b2ae35u;
+      h ^= h >> 16;
+      double u = (h + 0.5) / 4294967296.0;
+      // Metrics below the wire resolution count as that resolution
+      double weight = 1.0 / std::max (j->GetMetric (), 1.0 / 16);
+      double score = weight / -std::log (u);
+      if (chosen == 0 || score > bestScore)
+        {
+          chosen = &*j;
+          bestScore = score;
+        }
+    }
+  if (chosen == 0)
+    {
+      // Every candidate has expired: let the plain lookup clean up
+      return LookupRoute (dst);
+    }
+  return chosen;
+}
+
+const std::vector<DlarpRoutingTableEntry> *
+DlarpRoutingTable::GetCandidates (Ipv4Address dst) const
+{
+  const Slot &slot = m_slots[Find (dst)];
+  if (!slot.used)
+    {
+      return 0;
+    }
+  return &slot.candidates;
+}
+
+void
+DlarpRoutingTable::DeleteRoutesVia (const std::set<Ipv4Address> &nextHops,
+                                    std::vector<std::pair<Ipv4Address, Time> > &unreachable)
+{
+  uint32_t i = 0;
+  while (i < m_slots.size ())
+    {
+      Slot &slot = m_slots[i];
+      if (slot.used)
+        {
+          Time lastUsed;
+          std::vector<DlarpRoutingTableEntry>::iterator end =
+            std::remove_if (slot.candidates.begin (), slot.candidates.end (),
+                            [&nextHops, &lastUsed](const DlarpRoutingTableEntry &e) {
+                              if (nextHops.find (e.GetNextHop ()) == nextHops.end ())
+                                {
+                                  return false;
+                                }
+                              lastUsed = Max (lastUsed, e.GetLastUsed ());
+                              return true;
+                            });
+          if (end != slot.candidates.end ())
+            {
+              slot.candidates.erase (end, slot.candidates.end ());
+              if (slot.candidates.empty ())
+                {
+                  unreachable.push_back (std::make_pair (slot.dst, lastUsed));
+                  // Erase may shift another used bucket into i: look at it again
+                  Erase (i);
+                  continue;
+                }
+              UpdateBest (slot);
+            }
+        }
+      ++i;
+    }
+}
+
+bool
+DlarpRoutingTable::Purge (Ipv4Address dst, Time &nextExpiry)
+{
+  uint32_t i = Find (dst);
+  Slot &slot = m_slots[i];
+  if (!slot.used)
+    {
+      return false;
+    }
+  PurgeSlot (slot);
+  if (slot.candidates.empty ())
+    {
+      Erase (i);
+      return false;
+    }
+  nextExpiry = slot.candidates.front ().GetLifeTime ();
+  for (std::vector<DlarpRoutingTableEntry>::const_iterator j = slot.candidates.begin ();
+       j != slot.candidates.end (); ++j)
+    {
+      nextExpiry = Min (nextExpiry, j->GetLifeTime ());
+    }
+  return true;
+}
+
+void
+DlarpRoutingTable::Purge ()
+{
+  uint32_t i = 0;
+  while (i < m_slots.size ())
+    {
+      if (m_slots[i].used)
+        {
+          PurgeSlot (m_slots[i]);
+          if (m_slots[i].candidates.empty ())
+            {
+              // Erase may shift another used bucket into i: look at it again
+              Erase (i);
+              continue;
+            }
+        }
+      ++i;
+    }
+}
+
+void
+DlarpRoutingTable::InvalidateRoutes ()
+{
+  for (std::vector<Slot>::iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      for (std::vector<DlarpRoutingTableEntry>::iterator j = i->candidates.begin ();
+           j != i->candidates.end (); ++j)
+        {
+          j->SetRoute (0);
+        }
+    }
+}
+
+void
+DlarpRoutingTable::Clear ()
+{
+  m_slots.assign (DLARP_RTABLE_MIN_SLOTS, Slot ());
+  m_shift = 32 - 4;
+  m_size = 0;
+}
+
+uint32_t
+DlarpRoutingTable::GetNDestinations () const
+{
+  return m_size;
+}
+
+DlarpRoutingTable::MemoryUsage
+DlarpRoutingTable::GetMemoryUsage () const
+{
+  MemoryUsage usage;
+  usage.slots = m_slots.size ();
+  usage.destinations = m_size;
+  usage.candidates = 0;
+  usage.capacity = 0;
+  for (std::vector<Slot>::const_iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      usage.candidates += i->candidates.size ();
+      usage.capacity += i->candidates.capacity ();
+    }
+  usage.bytes = uint64_t (m_slots.capacity ()) * sizeof (Slot)
+    + uint64_t (usage.capacity) * sizeof (DlarpRoutingTableEntry);
+  return usage;
+}
+
+void
+DlarpRoutingTable::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+  std::vector<const Slot *> slots;
+  for (std::vector<Slot>::const_iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      if (i->used)
+        {
+          slots.push_back (&(*i));
+        }
+    }
+  std::sort (slots.begin (), slots.end (),
+             [](const Slot *a, const Slot *b) {
+               return a->dst < b->dst;
+             });
+
+  *stream->GetStream () << "Destination\tNextHop\tInterface\tSeqNo\tMetric\tLifetime" << std::endl;
+
+  for (std::vector<const Slot *>::const_iterator i = slots.begin (); i != slots.end (); ++i)
+    {
+      for (std::vector<DlarpRoutingTableEntry>::const_iterator j = (*i)->candidates.begin ();
+           j != (*i)->candidates.end (); ++j)
+        {
+          *stream->GetStream () << (*i)->dst << "\t"
+                                << j->GetNextHop () << "\t"
+                                << j->GetInterface () << "\t"
+                                << j->GetSeqNo () << "\t"
+                                << j->GetMetric () << "\t"
+                                << (j->GetLifeTime () - Simulator::Now ()).As (unit) << std::endl;
+        }
+    }
+}
+
+void
+DlarpRoutingTable::AppendSnapshot (uint32_t node, std::vector<DlarpSnapshotRecord> &records) const
+{
+  int64_t now = Simulator::Now ().GetNanoSeconds ();
+  for (std::vector<Slot>::const_iterator i = m_slots.begin (); i != m_slots.end (); ++i)
+    {
+      if (!i->used)
+        {
+          continue;
+        }
+      for (uint32_t c = 0; c < i->candidates.size (); ++c)
+        {
+          const DlarpRoutingTableEntry &entry = i->candidates[c];
+          DlarpSnapshotRecord record;
+          record.time = now;
+          record.node = node;
+          record.address = i->dst.Get ();
+          record.nextHop = entry.GetNextHop ().Get ();
+          record.seqNo = entry.GetSeqNo ();
+          record.metric = entry.GetMetric ();
+          record.lifetime = DlarpSnapshotRecord::EncodeLifetime (entry.GetLifeTime () - Simulator::Now ());
+          record.interface = entry.GetInterface ();
+          record.kind = DlarpSnapshotRecord::ROUTE;
+          record.flags = (int32_t (c) == i->best) ? DlarpSnapshotRecord::FLAG_BEST : 0;
+          record.reserved = 0;
+          records.push_back (record);
+        }
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,288 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_RTABLE_H
+#define DLARP_RTABLE_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/ipv4-route.h"
+#include "dlarp-snapshot.h"
+#include <vector>
+#include <set>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Routing table entry for DLARP.
+ *
+ * Entries are stored compactly, since a gateway may hold tens of
+ * thousands of them: the interface index is 16 bits wide, the metric is
+ * kept in the 12.4 fixed point of the wire format, and the lifetime as
+ * an absolute number of milliseconds, like the time of the last data
+ * packet this node sent along the route.  The accessors convert, so that
+ * metrics are rounded to 1/16 (and saturate at 4095.9375) and times
+ * are rounded up to the next millisecond (and saturate after 49 days of
+ * simulated time).
+ */
+class DlarpRoutingTableEntry
+{
+public:
+  DlarpRoutingTableEntry ();
+
+  // Constructors
+  DlarpRoutingTableEntry (Ipv4Address dst, Ipv4Address nextHop, uint32_t interface, uint32_t seqNo);
+
+  // Getters and setters
+  Ipv4Address GetDestination () const;
+  Ipv4Address GetNextHop () const;
+  uint32_t GetInterface () const;
+  uint32_t GetSeqNo () const;
+  Time GetLifeTime () const;
+  double GetMetric () const;
+  Ptr<Ipv4Route> GetRoute () const;
+  /// \return when this node last sent its own data along the route, 0 if never
+  Time GetLastUsed () const;
+
+  void SetLifeTime (Time lifeTime);
+  void SetMetric (double metric);
+  void SetNextHop (Ipv4Address nextHop);
+  void SetInterface (uint32_t interface);
+  void SetSeqNo (uint32_t seqNo);
+  void SetRoute (Ptr<Ipv4Route> route);
+  void SetLastUsed (Time lastUsed);
+
+private:
+  Ptr<Ipv4Route> m_route;       //!< Cached IPv4 route, built on first use
+  Ipv4Address m_destination;    //!< Destination address
+  Ipv4Address m_nextHop;        //!< Next hop address
+  uint32_t m_seqNo;             //!< Sequence number
+  uint32_t m_lifeTime;          //!< Expiration time, in milliseconds
+  uint32_t m_lastUsed;          //!< Last data packet of this node along the route, in milliseconds
+  uint16_t m_metric;            //!< Route metric, in 12.4 fixed point
+  uint16_t m_interface;         //!< Output interface
+};
+
+/**
+ * \ingroup dlarp
+ * \brief DLARP routing table.
+ *
+ * Open-addressing hash table (linear probing, backward-shift deletion)
+ * keyed on the destination address.  Every destination keeps its list of
+ * candidate routes together with the index of the best one, which is
+ * recomputed only when a candidate is added, changes metric, is removed
+ * or is found expired.  A lookup is therefore a single probe sequence
+ * with no sorting and no copying of entries.
+ *
+ * The number of candidates of a destination may be capped: once it is
+ * reached, a new candidate takes the place of the worst one if it is
+ * better, and is ignored otherwise.
+ */
+class DlarpRoutingTable
+{
+public:
+  /// Memory held by a routing table
+  struct MemoryUsage
+  {
+    uint32_t slots;             //!< Buckets, used or not
+    uint32_t destinations;      //!< Used buckets
+    uint32_t candidates;        //!< Candidate routes
+    uint32_t capacity;          //!< Candidate routes the buckets have room for
+    uint64_t bytes;             //!< Bytes of buckets and candidate arrays
+  };
+
+  DlarpRoutingTable ();
+
+  /**
+   * \brief Cap the number of candidates per destination
+   *
+   * Destinations holding more candidates lose their worst ones at once.
+   *
+   * \param maxCandidates the cap, 0 for none
+   */
+  void SetMaxCandidates (uint32_t maxCandidates);
+  /// \return the cap on the number of candidates per destination, 0 for none
+  uint32_t GetMaxCandidates () const;
+  /**
+   * \brief Add a candidate route, or refresh the candidate with the same next hop
+   *
+   * A refresh keeps the cached route, if the interface is the same, and
+   * the later of the two last-use times.
+   *
+   * A new next hop towards a destination that has reached the candidate
+   * cap replaces the worst candidate, an expired one first, if it has a
+   * lower metric; otherwise it is ignored.
+   *
+   * \param entry the route
+   * \return true if the best route towards the destination changed
+   */
+  bool AddRoute (const DlarpRoutingTableEntry &entry);
+  /**
+   * \brief Change the metric of an existing candidate
+   * \param dst the destination
+   * \param nextHop the next hop identifying the candidate
+   * \param metric the new metric
+   * \return true if the best route towards the destination changed
+   */
+  bool SetMetric (Ipv4Address dst, Ipv4Address nextHop, double metric);
+  /**
+   * \brief Remove the candidate towards dst through nextHop
+   * \param dst the destination
+   * \param nextHop the next hop identifying the candidate
+   * \return true if a candidate was removed
+   */
+  bool DeleteRoute (Ipv4Address dst, Ipv4Address nextHop);
+  /**
+   * \brief Remove every candidate towards dst
+   * \param dst the destination
+   * \return true if the destination was known
+   */
+  bool DeleteRoutes (Ipv4Address dst);
+  /**
+   * \brief Look up the best valid route towards dst
+   *
+   * If the precomputed best candidate has expired, the expired candidates
+   * of this destination are dropped and the best one is recomputed.
+   *
+   * \param dst the destination
+   * \return the best route, or 0 if there is no valid route.  The pointer
+   *         is only valid until the table is next modified, and only the
+   *         cached Ipv4Route may be changed through it.
+   */
+  DlarpRoutingTableEntry * LookupRoute (Ipv4Address dst);
+  /**
+   * \brief Pick the valid route of a flow towards dst
+   *
+   * Weighted rendezvous hashing over the valid candidates: every candidate
+   * scores the flow with a hash of the flow and of its next hop, scaled by
+   * the inverse of its metric, and the highest score wins.  A flow thus
+   * keeps its path as long as that candidate stays valid, flows spread in
+   * proportion to the inverse metric, and a candidate appearing or
+   * disappearing only moves the flows it wins or loses.
+   *
+   * \param dst the destination
+   * \param flowHash hash of the flow identifier
+   * \return the route, or 0 if there is no valid route; same validity as
+   *         LookupRoute (Ipv4Address)
+   */
+  DlarpRoutingTableEntry * LookupRoute (Ipv4Address dst, uint32_t flowHash);
+  /**
+   * \param dst the destination
+   * \return the candidates towards dst (possibly expired), or 0 if unknown
+   */
+  const std::vector<DlarpRoutingTableEntry> * GetCandidates (Ipv4Address dst) const;
+  /**
+   * \brief Remove every candidate whose next hop is in nextHops
+   * \param nextHops the next hops, typically neighbors that were lost
+   * \param unreachable receives the destinations left without any candidate,
+   *        each with the latest last-use time of its candidates
+   */
+  void DeleteRoutesVia (const std::set<Ipv4Address> &nextHops,
+                        std::vector<std::pair<Ipv4Address, Time> > &unreachable);
+  /**
+   * \brief Drop every expired candidate
+   */
+  void Purge ();
+  /**
+   * \brief Drop the expired candidates towards dst
+   * \param dst the destination
+   * \param nextExpiry receives the earliest lifetime among the remaining candidates
+   * \return true if dst still has candidates
+   */
+  bool Purge (Ipv4Address dst, Time &nextExpiry);
+  /**
+   * \brief Drop the cached Ipv4Route of every entry
+   *
+   * Needed when interface addresses or devices change, since the cached
+   * routes embed the output device and the source address.
+   */
+  void InvalidateRoutes ();
+  /**
+   * \brief Remove all the routes
+   */
+  void Clear ();
+  /**
+   * \return the number of destinations in the table
+   */
+  uint32_t GetNDestinations () const;
+  /**
+   * \return the memory held by the table, not counting the cached
+   *         Ipv4Routes that entries share with the packets in flight
+   */
+  MemoryUsage GetMemoryUsage () const;
+  /**
+   * \brief Print the routing table, ordered by destination
+   * \param stream the output stream
+   * \param unit the time unit used for the remaining lifetime
+   */
+  void Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
+  /**
+   * \brief Append a snapshot record for every candidate, in table order
+   * \param node the ID of the node of the table
+   * \param records receives the records
+   */
+  void AppendSnapshot (uint32_t node, std::vector<DlarpSnapshotRecord> &records) const;
+
+private:
+  /// Hash table bucket
+  struct Slot
+  {
+    Slot ();
+    std::vector<DlarpRoutingTableEntry> candidates; //!< Candidate routes
+    Ipv4Address dst;                                //!< Destination address (the key)
+    int16_t best;                                   //!< Index of the best candidate, -1 if none
+    bool used;                                      //!< Whether the bucket holds a destination
+  };
+
+  /**
+   * \param dst the destination
+   * \return the home bucket of dst
+   */
+  uint32_t Hash (Ipv4Address dst) const;
+  /**
+   * \param dst the destination
+   * \return the bucket holding dst, or the empty bucket where it would go
+   */
+  uint32_t Find (Ipv4Address dst) const;
+  /**
+   * \brief Recompute the best candidate of a bucket
+   * \param slot the bucket
+   * \return true if the best candidate changed
+   */
+  bool UpdateBest (Slot &slot);
+  /**
+   * \param slot a bucket with candidates
+   * \return the index of its first expired candidate, or else of the one
+   *         with the highest metric
+   */
+  uint32_t Worst (const Slot &slot) const;
+  /**
+   * \brief Drop the worst candidates of a bucket above the cap
+   * \param slot the bucket
+   */
+  void TrimSlot (Slot &slot);
+  /**
+   * \brief Drop the expired candidates of a bucket
+   * \param slot the bucket
+   * \return true if any candidate was dropped
+   */
+  bool PurgeSlot (Slot &slot);
+  /**
+   * \brief Free a bucket, shifting back the following ones of its cluster
+   * \param index the bucket
+   */
+  void Erase (uint32_t index);
+  /**
+   * \brief Double the number of buckets
+   */
+  void Grow ();
+
+  std::vector<Slot> m_slots;    //!< Buckets, a power of two
+  uint32_t m_shift;             //!< 32 - log2 (number of buckets)
+  uint32_t m_size;              //!< Number of used buckets
+  uint32_t m_maxCandidates;     //!< Cap on the candidates of a destination, 0 for none
+};
+
+} // namespace ns3
+
+#endif /* DLARP_RTABLE_H */
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-session-cache.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+DlarpSessionCache::DlarpSessionCache (Time lifetime) :
+  m_lifetime (lifetime)
+{
+}
+
+DlarpSessionCache::Session *
+DlarpSessionCache::Lookup (Ipv4Address neighbor)
+{
+  std::map<Ipv4Address, Session>::iterator it = m_sessions.find (neighbor);
+  if (it == m_sessions.end ())
+    {
+      return 0;
+    }
+  if (it->second.expire <= Simulator::Now ())
+    {
+      m_sessions.erase (it);
+      return 0;
+    }
+  return &it->second;
+}
+
+void
+DlarpSessionCache::Insert (Ipv4Address neighbor, uint32_t id)
+{
+  Session &session = m_sessions[neighbor];
+  session.id = id;
+  session.expire = Simulator::Now () + m_lifetime;
+  session.suspended = false;
+}
+
+void
+DlarpSessionCache::NeighborLost (Ipv4Address neighbor, bool resume)
+{
+  std::map<Ipv4Address, Session>::iterator it = m_sessions.find (neighbor);
+  if (it == m_sessions.end ())
+    {
+      return;
+    }
+  if (resume)
+    {
+      it->second.suspended = true;
+    }
+  else
+    {
+      m_sessions.erase (it);
+    }
+}
+
+void
+DlarpSessionCache::Purge ()
+{
+  Time now = Simulator::Now ();
+  for (std::map<Ipv4Address, Session>::iterator it = m_sessions.begin (); it != m_sessions.end (); )
+    {
+      if (it->second.expire <= now)
+        {
+          m_sessions.erase (it++);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+}
+
+void
+DlarpSessionCache::Clear ()
+{
+  m_sessions.clear ();
+}
+
+void
+DlarpSessionCache::SetLifetime (Time lifetime)
+{
+  m_lifetime = lifetime;
+}
+
+Time
+DlarpSessionCache::GetLifetime () const
+{
+  return m_lifetime;
+}
+
+uint32_t
+DlarpSessionCache::GetSize () const
+{
+  return m_sessions.size ();
+}
+
+} // namespace ns3
@@ -0,0 +1,77 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_SESSION_CACHE_H
+#define DLARP_SESSION_CACHE_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Authenticated sessions with the neighbors.
+ *
+ * A session is established by the M1-M3 handshake and lasts for a fixed
+ * lifetime from then on.  When its neighbor is lost, the session is
+ * either dropped or, for resumption, kept suspended until it expires: a
+ * route through that neighbor found again by a later discovery or repair
+ * then uses the session without a new handshake.
+ */
+class DlarpSessionCache
+{
+public:
+  /// An authenticated session
+  struct Session
+  {
+    uint32_t id;           //!< ID of the handshake that established it
+    Time expire;           //!< Expiration time
+    bool suspended;        //!< Whether its neighbor was lost since it was last used
+  };
+
+  /**
+   * \brief Constructor
+   * \param lifetime lifetime of a session
+   */
+  DlarpSessionCache (Time lifetime);
+
+  /**
+   * \param neighbor the neighbor
+   * \return the live session with neighbor, suspended or not, or 0
+   */
+  Session * Lookup (Ipv4Address neighbor);
+  /**
+   * \brief Record a session just established, replacing any older one
+   * \param neighbor the neighbor
+   * \param id the ID of the handshake
+   */
+  void Insert (Ipv4Address neighbor, uint32_t id);
+  /**
+   * \brief Handle the loss of a neighbor
+   * \param neighbor the neighbor
+   * \param resume whether its session is kept, suspended, or dropped
+   */
+  void NeighborLost (Ipv4Address neighbor, bool resume);
+  /// \brief Drop the expired sessions
+  void Purge ();
+  /// \brief Drop every session
+  void Clear ();
+
+  /**
+   * \brief Set the lifetime of the sessions established from now on
+   * \param lifetime the lifetime
+   */
+  void SetLifetime (Time lifetime);
+  /// \return the lifetime of a session
+  Time GetLifetime () const;
+  /// \return the number of sessions, expired ones included until purged
+  uint32_t GetSize () const;
+
+private:
+  std::map<Ipv4Address, Session> m_sessions;  //!< Sessions, by neighbor
+  Time m_lifetime;                            //!< Lifetime of a session
+};
+
+} // namespace ns3
+
+#endif /* DLARP_SESSION_CACHE_H */
@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-snapshot.h"
+#include "ns3/abort.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <set>
+
+namespace ns3 {
+
+static_assert (sizeof (DlarpSnapshotRecord) == 40, "DLARP snapshot records must stay 40 bytes");
+static_assert (sizeof (DlarpSnapshotFileHeader) == 16, "The DLARP snapshot header must stay 16 bytes");
+
+/// Size of the stdio buffer of a snapshot file
+static const size_t DLARP_SNAPSHOT_BUFFER_SIZE = 1 << 20;
+
+int32_t
+DlarpSnapshotRecord::EncodeLifetime (Time remaining)
+{
+  int64_t ms = remaining.GetMilliSeconds ();
+  ms = std::max<int64_t> (ms, std::numeric_limits<int32_t>::min ());
+  return std::min<int64_t> (ms, std::numeric_limits<int32_t>::max ());
+}
+
+DlarpSnapshotWriter::DlarpSnapshotWriter (std::string filename) :
+  m_fileBuffer (DLARP_SNAPSHOT_BUFFER_SIZE)
+{
+  // The first writer of the run starts the file afresh: records of an
+  // earlier run, or of another format version, never precede ours.  The
+  // later writers of the run share it, in append mode
+  static std::set<std::string> opened;
+  if (opened.insert (filename).second)
+    {
+      std::FILE *file = std::fopen (filename.c_str (), "wb");
+      NS_ABORT_MSG_IF (file == 0, "Cannot open " << filename);
+      std::fclose (file);
+    }
+  m_file = std::fopen (filename.c_str (), "ab");
+  NS_ABORT_MSG_IF (m_file == 0, "Cannot open " << filename);
+  std::setvbuf (m_file, &m_fileBuffer[0], _IOFBF, m_fileBuffer.size ());
+  std::fseek (m_file, 0, SEEK_END);
+  if (std::ftell (m_file) == 0)
+    {
+      DlarpSnapshotFileHeader header;
+      std::memcpy (header.magic, "DLARPSNP", sizeof (header.magic));
+      header.byteOrder = DlarpSnapshotFileHeader::BYTE_ORDER_MARK;
+      header.version = DlarpSnapshotFileHeader::VERSION;
+      header.recordSize = sizeof (DlarpSnapshotRecord);
+      std::fwrite (&header, sizeof (header), 1, m_file);
+      // The other writers of the run must find it there
+      std::fflush (m_file);
+    }
+}
+
+DlarpSnapshotWriter::~DlarpSnapshotWriter ()
+{
+  std::fclose (m_file);
+}
+
+void
+DlarpSnapshotWriter::Write (const std::vector<DlarpSnapshotRecord> &records)
+{
+  if (!records.empty ())
+    {
+      std::fwrite (&records[0], sizeof (DlarpSnapshotRecord), records.size (), m_file);
+    }
+}
+
+void
+DlarpSnapshotWriter::Flush ()
+{
+  std::fflush (m_file);
+}
+
+std::vector<DlarpSnapshotRecord> &
+DlarpSnapshotWriter::GetBuffer ()
+{
+  return m_records;
+}
+
+} // namespace ns3
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_SNAPSHOT_H
+#define DLARP_SNAPSHOT_H
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief One fixed-size record of a DLARP snapshot file: a route
+ * candidate or a neighbor of one node at one time.
+ *
+ * Records are written in host byte order, as laid out here; the file
+ * header tells readers which byte order that was.
+ */
+struct DlarpSnapshotRecord
+{
+  /// What a record describes
+  enum Kind
+  {
+    ROUTE = 0,                 //!< A candidate route
+    NEIGHBOR = 1               //!< A neighbor
+  };
+  /// Record flags
+  enum Flags
+  {
+    FLAG_BEST = 1              //!< The best candidate towards its destination
+  };
+
+  /**
+   * \param remaining a remaining lifetime
+   * \return it in milliseconds, saturated to the lifetime field
+   */
+  static int32_t EncodeLifetime (Time remaining);
+
+  int64_t time;                //!< Time of the snapshot, in nanoseconds
+  uint32_t node;               //!< Node ID
+  uint32_t address;            //!< Destination, or neighbor
+  uint32_t nextHop;            //!< Next hop of a route, 0 for a neighbor
+  uint32_t seqNo;              //!< Destination sequence number of a route, 0 for a neighbor
+  float metric;                //!< Route metric, or ETX of the link with a neighbor
+  int32_t lifetime;            //!< Remaining lifetime in milliseconds, negative once expired
+  uint16_t interface;          //!< Output interface of a route, 0 for a neighbor
+  uint8_t kind;                //!< Kind
+  uint8_t flags;               //!< Flags
+  uint32_t reserved;           //!< Zero; keeps the records 8-byte aligned
+};
+
+/**
+ * \ingroup dlarp
+ * \brief Header at the start of a DLARP snapshot file
+ */
+struct DlarpSnapshotFileHeader
+{
+  /// Value of byteOrder, read back as such in the byte order of the writer
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  /// Current format version
+  static const uint16_t VERSION = 1;
+
+  char magic[8];               //!< "DLARPSNP"
+  uint32_t byteOrder;          //!< BYTE_ORDER_MARK
+  uint16_t version;            //!< Format version
+  uint16_t recordSize;         //!< sizeof (DlarpSnapshotRecord)
+};
+
+/**
+ * \ingroup dlarp
+ * \brief Append-only writer of a DLARP snapshot file
+ *
+ * The file starts with a DlarpSnapshotFileHeader and continues with
+ * DlarpSnapshotRecords, snapshot after snapshot, so that it can be
+ * mapped in memory and read as an array.  The first writer of a file in
+ * a run truncates it; the other writers of the run append to it.
+ */
+class DlarpSnapshotWriter : public SimpleRefCount<DlarpSnapshotWriter>
+{
+public:
+  /**
+   * \brief Open a snapshot file, truncating it if no writer of this run
+   * opened it yet, and writing its header if it is empty
+   * \param filename the file
+   */
+  DlarpSnapshotWriter (std::string filename);
+  ~DlarpSnapshotWriter ();
+
+  /**
+   * \brief Append records to the file; they are buffered until Flush
+   * \param records the records
+   */
+  void Write (const std::vector<DlarpSnapshotRecord> &records);
+  /// \brief Flush the buffered records to the file
+  void Flush ();
+  /**
+   * \return a buffer for the records of one snapshot, reused from one
+   *         snapshot to the next
+   */
+  std::vector<DlarpSnapshotRecord> & GetBuffer ();
+
+private:
+  DlarpSnapshotWriter (const DlarpSnapshotWriter &);
+  DlarpSnapshotWriter & operator= (const DlarpSnapshotWriter &);
+
+  std::FILE *m_file;                          //!< The file
+  std::vector<char> m_fileBuffer;             //!< stdio buffer of the file
+  std::vector<DlarpSnapshotRecord> m_records; //!< Records of the snapshot being taken
+};
+
+} // namespace ns3
+
+#endif /* DLARP_SNAPSHOT_H */
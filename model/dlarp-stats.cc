@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-stats.h"
+#include "dlarp-packet.h"
+#include <algorithm>
+
+namespace ns3 {
+
+DlarpStats::DlarpStats ()
+{
+  Clear ();
+}
+
+void
+DlarpStats::Clear ()
+{
+  std::fill (txPackets, txPackets + TYPE_COUNT, 0);
+  std::fill (txBytes, txBytes + TYPE_COUNT, 0);
+  std::fill (rxPackets, rxPackets + TYPE_COUNT, 0);
+  std::fill (rxBytes, rxBytes + TYPE_COUNT, 0);
+  txDatagrams = 0;
+  rxDatagrams = 0;
+  rxInvalid = 0;
+  discoveriesStarted = 0;
+  discoveriesSucceeded = 0;
+  discoveriesFailed = 0;
+  discoveryLatency = Time ();
+  maxDiscoveryLatency = Time ();
+  rreqIdOverwrites = 0;
+  linkBreaks = 0;
+  repairsStarted = 0;
+  repairsSucceeded = 0;
+  repairsFailed = 0;
+  handshakesStarted = 0;
+  handshakesSucceeded = 0;
+  handshakesFailed = 0;
+  sessionsResumed = 0;
+  handshakeLatency = Time ();
+  maxHandshakeLatency = Time ();
+  macVerified = 0;
+  macFailures = 0;
+  macBatches = 0;
+  macDelay = Time ();
+  routeHits = 0;
+  routeMisses = 0;
+  std::fill (drops, drops + DROP_REASON_COUNT, 0);
+  tableSize = 0;
+  tableCandidates = 0;
+  tableBytes = 0;
+}
+
+DlarpStats &
+DlarpStats::operator+= (const DlarpStats &other)
+{
+  for (uint32_t t = 0; t < TYPE_COUNT; ++t)
+    {
+      txPackets[t] += other.txPackets[t];
+      txBytes[t] += other.txBytes[t];
+      rxPackets[t] += other.rxPackets[t];
+      rxBytes[t] += other.rxBytes[t];
+    }
+  txDatagrams += other.txDatagrams;
+  rxDatagrams += other.rxDatagrams;
+  rxInvalid += other.rxInvalid;
+  discoveriesStarted += other.discoveriesStarted;
+  discoveriesSucceeded += other.discoveriesSucceeded;
+  discoveriesFailed += other.discoveriesFailed;
+  discoveryLatency += other.discoveryLatency;
+  maxDiscoveryLatency = std::max (maxDiscoveryLatency, other.maxDiscoveryLatency);
+  rreqIdOverwrites += other.rreqIdOverwrites;
+  linkBreaks += other.linkBreaks;
+  repairsStarted += other.repairsStarted;
+  repairsSucceeded += other.repairsSucceeded;
+  repairsFailed += other.repairsFailed;
+  handshakesStarted += other.handshakesStarted;
+  handshakesSucceeded += other.handshakesSucceeded;
+  handshakesFailed += other.handshakesFailed;
+  sessionsResumed += other.sessionsResumed;
+  handshakeLatency += other.handshakeLatency;
+  maxHandshakeLatency = std::max (maxHandshakeLatency, other.maxHandshakeLatency);
+  macVerified += other.macVerified;
+  macFailures += other.macFailures;
+  macBatches += other.macBatches;
+  macDelay += other.macDelay;
+  routeHits += other.routeHits;
+  routeMisses += other.routeMisses;
+  for (uint32_t r = 0; r < DROP_REASON_COUNT; ++r)
+    {
+      drops[r] += other.drops[r];
+    }
+  tableSize += other.tableSize;
+  tableCandidates += other.tableCandidates;
+  tableBytes += other.tableBytes;
+  return *this;
+}
+
+const char *
+DlarpStats::GetDropReasonName (DropReason reason)
+{
+  switch (reason)
+    {
+    case DROP_NO_ROUTE:
+      return "NoRoute";
+    case DROP_UNREACHABLE:
+      return "Unreachable";
+    case DROP_QUEUE_FULL:
+      return "QueueFull";
+    case DROP_QUEUE_TIMEOUT:
+      return "QueueTimeout";
+    case DROP_DISCOVERY_FAILED:
+      return "DiscoveryFailed";
+    case DROP_AUTH_FAILED:
+      return "AuthFailed";
+    case DROP_REPAIR_FAILED:
+      return "RepairFailed";
+    default:
+      return "Unknown";
+    }
+}
+
+uint64_t
+DlarpStats::GetTxPackets () const
+{
+  uint64_t total = 0;
+  for (uint32_t t = 0; t < TYPE_COUNT; ++t)
+    {
+      total += txPackets[t];
+    }
+  return total;
+}
+
+uint64_t
+DlarpStats::GetTxBytes () const
+{
+  uint64_t total = 0;
+  for (uint32_t t = 0; t < TYPE_COUNT; ++t)
+    {
+      total += txBytes[t];
+    }
+  return total;
+}
+
+Time
+DlarpStats::GetMeanDiscoveryLatency () const
+{
+  if (discoveriesSucceeded == 0)
+    {
+      return Time ();
+    }
+  return discoveryLatency / int64_t (discoveriesSucceeded);
+}
+
+Time
+DlarpStats::GetMeanHandshakeLatency () const
+{
+  if (handshakesSucceeded == 0)
+    {
+      return Time ();
+    }
+  return handshakeLatency / int64_t (handshakesSucceeded);
+}
+
+Time
+DlarpStats::GetMeanMacDelay () const
+{
+  if (macVerified == 0)
+    {
+      return Time ();
+    }
+  return macDelay / int64_t (macVerified);
+}
+
+void
+DlarpStats::Print (std::ostream &os) const
+{
+  static const char *typeNames[TYPE_COUNT] = { "", "HELLO", "RREQ", "RREP", "AGREEMENT",
+                                               "AUTH1", "AUTH2", "AUTH3", "RERR" };
+  for (uint32_t t = DLARPTYPE_HELLO; t < TYPE_COUNT; ++t)
+    {
+      os << typeNames[t] << ": tx " << txPackets[t] << " messages / " << txBytes[t] << " bytes, rx "
+         << rxPackets[t] << " messages / " << rxBytes[t] << " bytes" << std::endl;
+    }
+  os << "Datagrams: tx " << txDatagrams << ", rx " << rxDatagrams << std::endl;
+  os << "Invalid control packets: " << rxInvalid << std::endl;
+  os << "Route discoveries: " << discoveriesStarted << " started, " << discoveriesSucceeded
+     << " succeeded, " << discoveriesFailed << " failed" << std::endl;
+  os << "Discovery latency: mean " << GetMeanDiscoveryLatency ().As (Time::MS)
+     << ", max " << maxDiscoveryLatency.As (Time::MS) << std::endl;
+  os << "Duplicate RREQ cache: " << rreqIdOverwrites << " live entries overwritten" << std::endl;
+  os << "Link breaks detected by the MAC: " << linkBreaks << std::endl;
+  os << "Local repairs: " << repairsStarted << " started, " << repairsSucceeded << " succeeded, "
+     << repairsFailed << " failed" << std::endl;
+  os << "Authentication handshakes: " << handshakesStarted << " started, " << handshakesSucceeded
+     << " succeeded, " << handshakesFailed << " failed, " << sessionsResumed << " sessions resumed"
+     << std::endl;
+  os << "Handshake latency: mean " << GetMeanHandshakeLatency ().As (Time::MS)
+     << ", max " << maxHandshakeLatency.As (Time::MS) << std::endl;
+  os << "MAC verification: " << macVerified << " messages in " << macBatches << " batches, "
+     << macFailures << " failed, mean delay " << GetMeanMacDelay ().As (Time::MS) << std::endl;
+  os << "Route lookups: " << routeHits << " hits, " << routeMisses << " misses" << std::endl;
+  os << "Drops:";
+  for (uint32_t r = 0; r < DROP_REASON_COUNT; ++r)
+    {
+      os << " " << GetDropReasonName (DropReason (r)) << " " << drops[r];
+    }
+  os << std::endl;
+  os << "Routing table size: " << tableSize << " destinations, " << tableCandidates
+     << " candidates, " << tableBytes << " bytes" << std::endl;
+}
+
+std::ostream &
+operator<< (std::ostream &os, const DlarpStats &stats)
+{
+  stats.Print (os);
+  return os;
+}
+
+} // namespace ns3
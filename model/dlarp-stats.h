@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_STATS_H
+#define DLARP_STATS_H
+
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <ostream>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Counters of one DLARP instance, or the sum of several.
+ *
+ * The protocol only increments plain integers on its hot paths; the
+ * matching trace sources of DlarpRoutingProtocol give the individual
+ * events to whoever connects to them.
+ */
+struct DlarpStats
+{
+  /// Why a data packet was not forwarded
+  enum DropReason
+  {
+    DROP_NO_ROUTE = 0,          //!< No route to forward a transit packet
+    DROP_UNREACHABLE,           //!< Destination in the negative cache
+    DROP_QUEUE_FULL,            //!< No room in the send buffer
+    DROP_QUEUE_TIMEOUT,         //!< Waited too long in the send buffer
+    DROP_DISCOVERY_FAILED,      //!< Route discovery gave up
+    DROP_AUTH_FAILED,           //!< Authentication of the next hop failed
+    DROP_REPAIR_FAILED,         //!< Local repair of a forwarded packet's route failed
+    DROP_REASON_COUNT           //!< Number of reasons
+  };
+
+  /// Counters are indexed by DlarpPacketType, 0 being unused
+  static const uint32_t TYPE_COUNT = 9;
+
+  DlarpStats ();
+
+  /// \brief Reset every counter
+  void Clear ();
+  /**
+   * \brief Add the counters of another instance; table sizes are summed
+   * \param other the other counters
+   * \return this
+   */
+  DlarpStats & operator+= (const DlarpStats &other);
+  /**
+   * \param reason a drop reason
+   * \return its name
+   */
+  static const char * GetDropReasonName (DropReason reason);
+  /// \return the total number of control messages sent
+  uint64_t GetTxPackets () const;
+  /// \return the total number of control bytes sent
+  uint64_t GetTxBytes () const;
+  /// \return the mean latency of the successful route discoveries
+  Time GetMeanDiscoveryLatency () const;
+  /// \return the mean latency of the successful authentication handshakes
+  Time GetMeanHandshakeLatency () const;
+  /// \return the mean time from the reception of a message to the end of its verification
+  Time GetMeanMacDelay () const;
+  /**
+   * \brief Print the counters, one per line
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const;
+
+  uint64_t txPackets[TYPE_COUNT];          //!< Control messages sent, by type
+  uint64_t txBytes[TYPE_COUNT];            //!< DLARP bytes sent, by type
+  uint64_t rxPackets[TYPE_COUNT];          //!< Control messages received and processed, by type
+  uint64_t rxBytes[TYPE_COUNT];            //!< DLARP bytes received and processed, by type
+  uint64_t txDatagrams;                    //!< Datagrams that carried the messages sent
+  uint64_t rxDatagrams;                    //!< Datagrams that carried the messages received
+  uint64_t rxInvalid;                      //!< Control packets that could not be parsed
+  uint64_t discoveriesStarted;             //!< Route discoveries started
+  uint64_t discoveriesSucceeded;           //!< Route discoveries that found a route
+  uint64_t discoveriesFailed;              //!< Route discoveries that gave up
+  Time discoveryLatency;                   //!< Sum of the latencies of the successful discoveries
+  Time maxDiscoveryLatency;                //!< Largest latency of a successful discovery
+  uint64_t rreqIdOverwrites;               //!< RREQs forgotten by the full duplicate cache before their lifetime
+  uint64_t linkBreaks;                     //!< Neighbors lost on a link-layer transmit failure
+  uint64_t repairsStarted;                 //!< Local repairs started
+  uint64_t repairsSucceeded;               //!< Local repairs that found a route
+  uint64_t repairsFailed;                  //!< Local repairs that gave up with a RERR
+  uint64_t handshakesStarted;              //!< Authentication handshakes started, either side
+  uint64_t handshakesSucceeded;            //!< Handshakes that established a session
+  uint64_t handshakesFailed;               //!< Handshakes that gave up
+  uint64_t sessionsResumed;                //!< Sessions reused with a neighbor that had been lost
+  Time handshakeLatency;                   //!< Sum of the latencies of the successful handshakes
+  Time maxHandshakeLatency;                //!< Largest latency of a successful handshake
+  uint64_t macVerified;                    //!< Messages whose MAC was checked, failed ones included
+  uint64_t macFailures;                    //!< Messages dropped for a wrong or missing MAC
+  uint64_t macBatches;                     //!< Verification batches
+  Time macDelay;                           //!< Sum of the waits of the messages for their verification
+  uint64_t routeHits;                      //!< Data packets that found a route
+  uint64_t routeMisses;                    //!< Data packets that found none
+  uint64_t drops[DROP_REASON_COUNT];       //!< Data packets dropped, by reason
+  uint32_t tableSize;                      //!< Destinations in the routing table
+  uint32_t tableCandidates;                //!< Candidate routes in the routing table
+  uint64_t tableBytes;                     //!< Memory held by the routing table
+};
+
+std::ostream & operator<< (std::ostream &os, const DlarpStats &stats);
+
+} // namespace ns3
+
+#endif /* DLARP_STATS_H */
@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dlarp-timer-wheel.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+DlarpTimerWheel::DlarpTimerWheel () :
+  m_current (0),
+  m_size (0)
+{
+}
+
+void
+DlarpTimerWheel::Place (uint64_t tick, const Timer &timer)
+{
+  uint64_t delta = tick - m_current;
+  uint32_t level = 0;
+  while (level < LEVELS - 1 && delta >= (uint64_t (1) << (SLOT_BITS * (level + 1))))
+    {
+      level++;
+    }
+  uint64_t range = uint64_t (1) << (SLOT_BITS * LEVELS);
+  uint64_t slotTick = tick;
+  if (delta >= range)
+    {
+      // Out of range: park it in the farthest coarse slot, it is placed
+      // again when that slot is cascaded
+      slotTick = m_current + range - 1;
+    }
+  uint32_t index = (slotTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+  m_slots[level][index].push_back (std::make_pair (tick, timer));
+}
+
+void
+DlarpTimerWheel::Insert (uint64_t tick, Kind kind, Ipv4Address address)
+{
+  if (tick <= m_current)
+    {
+      tick = m_current + 1;
+    }
+  Timer timer;
+  timer.address = address;
+  timer.kind = kind;
+  Place (tick, timer);
+  m_size++;
+}
+
+void
+DlarpTimerWheel::Cascade (uint32_t level, uint32_t index)
+{
+  std::vector<std::pair<uint64_t, Timer> > timers;
+  timers.swap (m_slots[level][index]);
+  for (std::vector<std::pair<uint64_t, Timer> >::const_iterator i = timers.begin (); i != timers.end (); ++i)
+    {
+      Place (i->first, i->second);
+    }
+}
+
+void
+DlarpTimerWheel::Advance (std::vector<Timer> &expired)
+{
+  m_current++;
+  // Entering a new block of a level: bring its next coarser slot down
+  for (uint32_t level = 1; level < LEVELS; ++level)
+    {
+      if ((m_current & ((uint64_t (1) << (SLOT_BITS * level)) - 1)) != 0)
+        {
+          break;
+        }
+      Cascade (level, (m_current >> (SLOT_BITS * level)) & (SLOTS - 1));
+    }
+
+  std::vector<std::pair<uint64_t, Timer> > &slot = m_slots[0][m_current & (SLOTS - 1)];
+  for (std::vector<std::pair<uint64_t, Timer> >::const_iterator i = slot.begin (); i != slot.end (); ++i)
+    {
+      NS_ASSERT (i->first == m_current);
+      expired.push_back (i->second);
+    }
+  m_size -= slot.size ();
+  slot.clear ();
+}
+
+uint64_t
+DlarpTimerWheel::GetCurrentTick () const
+{
+  return m_current;
+}
+
+void
+DlarpTimerWheel::SetCurrentTick (uint64_t tick)
+{
+  NS_ASSERT (m_size == 0);
+  m_current = tick;
+}
+
+bool
+DlarpTimerWheel::IsEmpty () const
+{
+  return m_size == 0;
+}
+
+uint32_t
+DlarpTimerWheel::GetSize () const
+{
+  return m_size;
+}
+
+} // namespace ns3
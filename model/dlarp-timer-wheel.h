@@ -0,0 +1,98 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DLARP_TIMER_WHEEL_H
+#define DLARP_TIMER_WHEEL_H
+
+#include "ns3/ipv4-address.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup dlarp
+ * \brief Hierarchical timer wheel for batched expiry.
+ *
+ * Time is counted in ticks.  Level 0 holds the timers due within the
+ * next 64 ticks, one slot per tick; every further level holds 64 times
+ * coarser slots, and a slot is cascaded down to the finer levels when
+ * the wheel reaches it.  Insertion and expiry are O(1) per timer, and
+ * advancing the wheel by one tick returns every timer due at that tick
+ * in one batch.
+ *
+ * Timers cannot be cancelled: the owner checks, when a timer fires,
+ * whether the object it refers to is still due and re-inserts it
+ * otherwise.
+ */
+class DlarpTimerWheel
+{
+public:
+  /// What a timer refers to
+  enum Kind
+  {
+    NEIGHBOR = 0, //!< Neighbor table entry
+    ROUTE = 1     //!< Routing table destination
+  };
+
+  /// A timer
+  struct Timer
+  {
+    Ipv4Address address;   //!< Neighbor or destination address
+    uint8_t kind;          //!< Kind of the timer
+  };
+
+  DlarpTimerWheel ();
+
+  /**
+   * \brief Add a timer
+   * \param tick the tick at which it fires; a tick already reached fires
+   *        at the next one, and ticks beyond the wheel range are clamped
+   * \param kind what the timer refers to
+   * \param address the neighbor or destination
+   */
+  void Insert (uint64_t tick, Kind kind, Ipv4Address address);
+  /**
+   * \brief Move to the next tick
+   * \param expired receives the timers due at that tick
+   */
+  void Advance (std::vector<Timer> &expired);
+  /// \return the last tick reached
+  uint64_t GetCurrentTick () const;
+  /**
+   * \brief Jump to a tick, only allowed while the wheel is empty
+   * \param tick the tick
+   */
+  void SetCurrentTick (uint64_t tick);
+  /// \return true if no timer is pending
+  bool IsEmpty () const;
+  /// \return the number of pending timers
+  uint32_t GetSize () const;
+
+private:
+  /// Number of slots per level, as a power of two
+  static const uint32_t SLOT_BITS = 6;
+  /// Number of slots per level
+  static const uint32_t SLOTS = 1 << SLOT_BITS;
+  /// Number of levels
+  static const uint32_t LEVELS = 4;
+
+  /**
+   * \brief Re-insert the timers of a slot into the finer levels
+   * \param level the level of the slot
+   * \param index the slot
+   */
+  void Cascade (uint32_t level, uint32_t index);
+  /**
+   * \brief Put a timer in its slot
+   * \param tick the tick at which it fires, after the current one
+   * \param timer the timer
+   */
+  void Place (uint64_t tick, const Timer &timer);
+
+  /// Slots of every level; each holds its timers and their ticks
+  std::vector<std::pair<uint64_t, Timer> > m_slots[LEVELS][SLOTS];
+  uint64_t m_current;    //!< Last tick reached
+  uint32_t m_size;       //!< Number of pending timers
+};
+
+} // namespace ns3
+
+#endif /* DLARP_TIMER_WHEEL_H */
@@ -1,16 +1,23 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 #include "dlarp.h"
+#include "dlarp-packet.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/wifi-net-device.h"
 #include "ns3/adhoc-wifi-mac.h"
+#include "ns3/wifi-remote-station-manager.h"
+#include "ns3/arp-cache.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/tag.h"
 #include <algorithm>
 #include <limits>
 
@@ -20,29 +27,53 @@ NS_LOG_COMPONENT_DEFINE ("DlarpRoutingProtocol");
 
 NS_OBJECT_ENSURE_REGISTERED (DlarpRoutingProtocol);
 
-// DLARP Packet Types
-enum DlarpPacketType
-{
-  DLARPTYPE_HELLO = 1,
-  DLARPTYPE_RREQ  = 2,
-  DLARPTYPE_RREP  = 3,
-  DLARPTYPE_AGREEMENT = 4
-};
+const uint16_t DlarpRoutingProtocol::DLARP_PORT = 654;
 
-// DLARP Packet Header Format
-struct DlarpHeader
+/**
+ * \brief Marks the unicast DLARP messages of this node on their way
+ * through RouteOutput
+ *
+ * They go to a neighbor, over the interface of their socket, and set up
+ * the sessions themselves: they are neither looked up in the routing table
+ * nor held for a session.
+ */
+class DlarpControlTag : public Tag
 {
-  uint8_t type;          // Packet type
-  uint32_t seqNo;        // Sequence number
-  uint32_t requestId;    // Request ID for RREQ
-  Ipv4Address src;       // Source address
-  Ipv4Address dst;       // Destination address
-  uint8_t hopCount;      // Hop count
-  double metric;         // Route metric
-
-  // Serialization and deserialization methods would go here
+public:
+  /**
+   * \brief Get the type ID
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::DlarpControlTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("Dlarp")
+      .AddConstructor<DlarpControlTag> ();
+    return tid;
+  }
+  TypeId GetInstanceTypeId () const
+  {
+    return GetTypeId ();
+  }
+  uint32_t GetSerializedSize () const
+  {
+    return 0;
+  }
+  void Serialize (TagBuffer i) const
+  {
+  }
+  void Deserialize (TagBuffer i)
+  {
+  }
+  void Print (std::ostream &os) const
+  {
+    os << "DlarpControlTag";
+  }
 };
 
+NS_OBJECT_ENSURE_REGISTERED (DlarpControlTag);
+
 TypeId
 DlarpRoutingProtocol::GetTypeId (void)
 {
@@ -54,21 +85,298 @@ DlarpRoutingProtocol::GetTypeId (void)
                    TimeValue (Seconds (1)),
                    MakeTimeAccessor (&DlarpRoutingProtocol::m_helloInterval),
                    MakeTimeChecker ())
+    .AddAttribute ("EnableMultipath",
+                   "Spread flows over every valid candidate route, weighted by "
+                   "the inverse of the route metric, instead of using the best one only",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_enableMultipath),
+                   MakeBooleanChecker ())
+    .AddAttribute ("AdaptiveHello",
+                   "Adapt the HELLO interval to the neighbor-set churn and skip "
+                   "HELLOs when a recent DLARP broadcast already announced the node",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_adaptiveHello),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MinHelloInterval", "Lower bound of the adaptive HELLO interval",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_minHelloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxHelloInterval",
+                   "Upper bound of the adaptive HELLO interval; never more than "
+                   "half the neighbor timeout",
+                   TimeValue (Seconds (4)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_maxHelloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("HelloChurnThreshold",
+                   "Neighbor-set changes per neighbor within one HELLO interval "
+                   "above which the adaptive interval is halved",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&DlarpRoutingProtocol::m_helloChurnThreshold),
+                   MakeDoubleChecker<double> (0))
     .AddAttribute ("RouteTimeout", "Route timeout",
                    TimeValue (Seconds (30)),
                    MakeTimeAccessor (&DlarpRoutingProtocol::m_routeTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("MaxCandidates",
+                   "Maximum number of candidate routes kept per destination; a "
+                   "better candidate replaces the worst one beyond it, 0 keeps them all",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::SetMaxCandidates,
+                                         &DlarpRoutingProtocol::GetMaxCandidates),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("NeighborTimeout", "Neighbor timeout",
                    TimeValue (Seconds (10)),
                    MakeTimeAccessor (&DlarpRoutingProtocol::m_neighborTimeout),
-                   MakeTimeChecker ());
+                   MakeTimeChecker ())
+    .AddAttribute ("LinkLayerFeedback",
+                   "Break the link with a neighbor as soon as the Wi-Fi MAC gives up "
+                   "sending it a frame, rather than when the neighbor times out",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_linkLayerFeedback),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EtxWindow",
+                   "Number of HELLOs over which the delivery ratio of a link is measured",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_etxWindow),
+                   MakeUintegerChecker<uint32_t> (1, DlarpLinkEstimator::MAX_WINDOW))
+    .AddAttribute ("AgreementWindow",
+                   "Time during which route changes are gathered into one AGREEMENT message",
+                   TimeValue (MilliSeconds (50)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_agreementWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("AggregationDelay",
+                   "How long a DLARP message may wait for others sent on the same "
+                   "interface to the same destination, to share one datagram up to "
+                   "the MTU; 0 sends every message in its own datagram",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_aggregationDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("ExpiryGranularity",
+                   "Tick of the timer wheel that expires neighbors and routes",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_expiryGranularity),
+                   MakeTimeChecker ())
+    .AddAttribute ("RreqTimeout",
+                   "Time to wait for a RREP before the first RREQ retry; "
+                   "doubled at every further retry",
+                   TimeValue (Seconds (2.8)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_rreqTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("RreqRetries", "Maximum number of RREQ retries of a route discovery",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_rreqRetries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ExpandingRing",
+                   "Search for a route in rings of growing TTL before flooding the "
+                   "whole network",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_expandingRing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("NodeTraversalTime",
+                   "Estimated time for a message to cross one hop, from which the "
+                   "wait of every ring is derived",
+                   TimeValue (MilliSeconds (40)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_nodeTraversalTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("TtlStart", "TTL of the first ring of an expanding-ring search",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_ttlStart),
+                   MakeUintegerChecker<uint32_t> (1, 255))
+    .AddAttribute ("TtlIncrement", "TTL added by every further ring",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_ttlIncrement),
+                   MakeUintegerChecker<uint32_t> (1, 255))
+    .AddAttribute ("TtlThreshold",
+                   "Largest ring TTL; the next RREQ floods the whole network",
+                   UintegerValue (7),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_ttlThreshold),
+                   MakeUintegerChecker<uint32_t> (1, 255))
+    .AddAttribute ("UnreachableTimeout",
+                   "How long a destination whose discovery failed is reported "
+                   "unreachable without a new discovery",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_unreachableTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("LocalRepair",
+                   "Repair a broken route of forwarded data where it broke, with a "
+                   "TTL-limited discovery, before sending a RERR to the source",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_localRepair),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LocalRepairTtl", "Number of hops a local repair RREQ may travel",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_localRepairTtl),
+                   MakeUintegerChecker<uint32_t> (1, 255))
+    .AddAttribute ("LocalRepairTimeout", "Wait for a RREP before a local repair fails",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_localRepairTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("RreqIdCacheSize",
+                   "Number of (originator, request ID) pairs remembered for "
+                   "duplicate RREQ detection; it should hold every RREQ heard "
+                   "within RreqIdCacheLifetime",
+                   UintegerValue (256),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::SetRreqIdCacheSize,
+                                         &DlarpRoutingProtocol::GetRreqIdCacheSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("RreqIdCacheLifetime", "How long a RREQ is remembered as seen",
+                   TimeValue (Seconds (5.6)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::SetRreqIdCacheLifetime,
+                                     &DlarpRoutingProtocol::GetRreqIdCacheLifetime),
+                   MakeTimeChecker ())
+    .AddAttribute ("RreqRebroadcastJitter",
+                   "Maximum random delay before a RREQ is rebroadcast",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_rreqRebroadcastJitter),
+                   MakeTimeChecker ())
+    .AddAttribute ("RreqSuppressionThreshold",
+                   "Cancel a pending RREQ rebroadcast once this many copies of "
+                   "the request have been received; 0 disables suppression",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_rreqSuppressionThreshold),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxQueueLen", "Maximum number of packets waiting for a route discovery",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::SetMaxQueueLen,
+                                         &DlarpRoutingProtocol::GetMaxQueueLen),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxQueueBytes", "Maximum number of bytes waiting for a route discovery",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::SetMaxQueueBytes,
+                                         &DlarpRoutingProtocol::GetMaxQueueBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxQueueTime", "Maximum time a packet may wait for a route discovery",
+                   TimeValue (Seconds (30)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::SetMaxQueueTime,
+                                     &DlarpRoutingProtocol::GetMaxQueueTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("QueueDropPolicy", "What to drop when a packet does not fit in the send buffer",
+                   EnumValue (DlarpRequestQueue::DROP_OLDEST),
+                   MakeEnumAccessor (&DlarpRoutingProtocol::SetQueueDropPolicy,
+                                     &DlarpRoutingProtocol::GetQueueDropPolicy),
+                   MakeEnumChecker (DlarpRequestQueue::DROP_OLDEST, "DropOldest",
+                                    DlarpRequestQueue::DROP_TAIL, "DropTail"))
+    .AddAttribute ("Authentication",
+                   "Authenticate every neighbor with the M1-M3 handshake before "
+                   "routing data through it",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_authentication),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SessionResumption",
+                   "Keep the session with a lost neighbor until it expires, so "
+                   "that later routes through the neighbor need no new handshake",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_sessionResumption),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SessionLifetime", "Lifetime of an authenticated session",
+                   TimeValue (Seconds (300)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::SetSessionLifetime,
+                                     &DlarpRoutingProtocol::GetSessionLifetime),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthM1Delay", "Processing time of the initiator to compute M1",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_authM1Delay),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthM2Delay", "Processing time of the responder to check M1 and compute M2",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_authM2Delay),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthM3Delay", "Processing time of the initiator to check M2 and compute M3",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_authM3Delay),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthM3CheckDelay", "Processing time of the responder to check M3",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_authM3CheckDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthTimeout",
+                   "Time to wait for the next message of a handshake before the "
+                   "initiator resends M1 or gives up, and the responder forgets it",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_authTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("AuthRetries", "Maximum number of M1 retransmissions of a handshake",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_authRetries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ControlMac",
+                   "Append to every DLARP message a truncated MAC keyed by its "
+                   "sender, and verify it before processing the message",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DlarpRoutingProtocol::m_controlMac),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MacSize", "Size of the truncated MAC, in bytes",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&DlarpRoutingProtocol::m_macSize),
+                   MakeUintegerChecker<uint32_t> (1, 8))
+    .AddAttribute ("MacBatchInterval",
+                   "Tick at which the messages received since the previous one are "
+                   "verified as one batch; 0 verifies every message as it arrives",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_macBatchInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MacBatchCost", "CPU time of a verification batch, whatever its size",
+                   TimeValue (MicroSeconds (500)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_macBatchCost),
+                   MakeTimeChecker ())
+    .AddAttribute ("MacMessageCost", "CPU time of the verification of one message",
+                   TimeValue (MicroSeconds (200)),
+                   MakeTimeAccessor (&DlarpRoutingProtocol::m_macMessageCost),
+                   MakeTimeChecker ())
+    .AddTraceSource ("Tx", "A DLARP message is sent",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_txTrace),
+                     "ns3::DlarpRoutingProtocol::ControlTracedCallback")
+    .AddTraceSource ("Rx", "A DLARP message is received and processed, after the verification of its MAC",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_rxTrace),
+                     "ns3::DlarpRoutingProtocol::ControlTracedCallback")
+    .AddTraceSource ("Discovery", "A route discovery ends, successfully or not",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_discoveryTrace),
+                     "ns3::DlarpRoutingProtocol::DiscoveryTracedCallback")
+    .AddTraceSource ("Lookup", "A data packet looks up its route",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_lookupTrace),
+                     "ns3::DlarpRoutingProtocol::LookupTracedCallback")
+    .AddTraceSource ("Drop", "A data packet is dropped",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_dropTrace),
+                     "ns3::DlarpRoutingProtocol::DropTracedCallback")
+    .AddTraceSource ("Handshake", "An authentication handshake ended",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_handshakeTrace),
+                     "ns3::DlarpRoutingProtocol::HandshakeTracedCallback")
+    .AddTraceSource ("TableSize", "Number of destinations in the routing table",
+                     MakeTraceSourceAccessor (&DlarpRoutingProtocol::m_tableSize),
+                     "ns3::TracedValueCallback::Uint32");
   return tid;
 }
 
 DlarpRoutingProtocol::DlarpRoutingProtocol () :
   m_ipv4 (0),
+  m_linkLayerFeedback (true),
+  m_enableMultipath (false),
+  m_adaptiveHello (false),
+  m_helloChurnThreshold (0.1),
+  m_neighborChurn (0),
+  m_rreqRetries (2),
+  m_expandingRing (true),
+  m_ttlStart (1),
+  m_ttlIncrement (2),
+  m_ttlThreshold (7),
+  m_localRepair (false),
+  m_localRepairTtl (3),
+  m_rreqIdCache (256, Seconds (5.6)),
+  m_rreqSuppressionThreshold (3),
+  m_expiryGranularity (MilliSeconds (500)),
+  m_authentication (false),
+  m_sessionResumption (true),
+  m_authRetries (2),
+  m_handshakeId (0),
+  m_sessions (Seconds (300)),
+  m_controlMac (false),
+  m_macSize (8),
+  m_queue (64, 65536, Seconds (30), DlarpRequestQueue::DROP_OLDEST),
+  m_etxWindow (10),
   m_seqNo (0),
-  m_requestId (0)
+  m_helloSeqNo (0),
+  m_requestId (0),
+  m_tableSize (0)
 {
   m_uniformRandomVariable = CreateObject<UniformRandomVariable> ();
 }
@@ -84,6 +392,8 @@ DlarpRoutingProtocol::SetIpv4 (Ptr<Ipv4> ipv4)
   NS_ASSERT (m_ipv4 == 0);
   
   m_ipv4 = ipv4;
+  m_lo = m_ipv4->GetNetDevice (0);
+  NS_ASSERT (m_lo != 0);
   
   // Create the DLARP protocol sockets
   for (uint32_t i = 0; i < m_ipv4->GetNInterfaces (); i++)
@@ -97,21 +407,45 @@ DlarpRoutingProtocol::SetIpv4 (Ptr<Ipv4> ipv4)
       Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (), tid);
       socket->SetRecvCallback (MakeCallback (&DlarpRoutingProtocol::RecvDlarp, this));
       socket->BindToNetDevice (m_ipv4->GetNetDevice (i));
-      socket->Bind (InetSocketAddress (iface.GetLocal (), 654));
+      socket->Bind (InetSocketAddress (iface.GetLocal (), DLARP_PORT));
       socket->SetAllowBroadcast (true);
       
       m_socketAddresses[socket] = iface;
+      ConnectLinkLayerFeedback (i);
     }
+  UpdateLocalAddresses ();
   
   // Schedule the first Hello message
-  m_helloTimer.SetFunction (&DlarpRoutingProtocol::SendHello, this);
+  m_currentHelloInterval = m_helloInterval;
+  m_helloTimer.SetFunction (&DlarpRoutingProtocol::HelloTimerFire, this);
   Time jitter = Seconds (m_uniformRandomVariable->GetValue (0, 0.1));
-  m_helloTimer.Schedule (m_helloInterval + jitter);
+  m_helloTimer.Schedule (m_currentHelloInterval + jitter);
+}
+
+void
+DlarpRoutingProtocol::UpdateLocalAddresses ()
+{
+  m_localAddresses.clear ();
+  m_localAddresses.insert (Ipv4Address::GetBroadcast ());
+  for (uint32_t i = 0; i < m_ipv4->GetNInterfaces (); i++)
+    {
+      if (!m_ipv4->IsUp (i))
+        continue;
+      
+      for (uint32_t j = 0; j < m_ipv4->GetNAddresses (i); j++)
+        {
+          Ipv4InterfaceAddress iface = m_ipv4->GetAddress (i, j);
+          m_localAddresses.insert (iface.GetLocal ());
+          m_localAddresses.insert (iface.GetBroadcast ());
+        }
+    }
 }
 
 void
 DlarpRoutingProtocol::NotifyInterfaceUp (uint32_t interface)
 {
+  UpdateLocalAddresses ();
+  
   // Add sockets for newly-up interfaces
   Ipv4InterfaceAddress iface = m_ipv4->GetAddress (interface, 0);
   if (iface.GetLocal () == Ipv4Address ("127.0.0.1"))
@@ -121,15 +455,20 @@ DlarpRoutingProtocol::NotifyInterfaceUp (uint32_t interface)
   Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (), tid);
   socket->SetRecvCallback (MakeCallback (&DlarpRoutingProtocol::RecvDlarp, this));
   socket->BindToNetDevice (m_ipv4->GetNetDevice (interface));
-  socket->Bind (InetSocketAddress (iface.GetLocal (), 654));
+  socket->Bind (InetSocketAddress (iface.GetLocal (), DLARP_PORT));
   socket->SetAllowBroadcast (true);
   
   m_socketAddresses[socket] = iface;
+  ConnectLinkLayerFeedback (interface);
 }
 
 void
 DlarpRoutingProtocol::NotifyInterfaceDown (uint32_t interface)
 {
+  // Cached routes may point at this interface's device and address
+  m_routingTable.InvalidateRoutes ();
+  UpdateLocalAddresses ();
+  
   // Close sockets for down interfaces
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator iter = m_socketAddresses.begin ();
        iter != m_socketAddresses.end (); )
@@ -149,12 +488,16 @@ DlarpRoutingProtocol::NotifyInterfaceDown (uint32_t interface)
 void
 DlarpRoutingProtocol::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
-  // Nothing to do here
+  UpdateLocalAddresses ();
 }
 
 void
 DlarpRoutingProtocol::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
+  // Cached routes may use the removed address as their source
+  m_routingTable.InvalidateRoutes ();
+  UpdateLocalAddresses ();
+  
   // Close socket associated with this address
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator iter = m_socketAddresses.begin ();
        iter != m_socketAddresses.end (); )
@@ -176,316 +519,1798 @@ DlarpRoutingProtocol::SendHello ()
 {
   NS_LOG_FUNCTION (this);
   
-  // Prepare a HELLO packet
-  DlarpHeader helloHeader;
-  helloHeader.type = DLARPTYPE_HELLO;
-  helloHeader.seqNo = ++m_seqNo;
+  // Prepare a HELLO packet; its own sequence space, so that gaps mean losses
+  DlarpHeader helloHeader (DLARPTYPE_HELLO);
+  helloHeader.SetSeqNo (++m_helloSeqNo);
+  
+  // Report how well every neighbor is heard, for its forward delivery ratio
+  for (std::map<Ipv4Address, NeighborEntry>::const_iterator i = m_neighborTable.begin ();
+       i != m_neighborTable.end () && helloHeader.GetNHelloRecords () < DLARP_MAX_HELLO_RECORDS; ++i)
+    {
+      DlarpHelloRecord record;
+      record.neighbor = i->first;
+      record.ratio = i->second.link.GetReverseRatio ();
+      helloHeader.AddHelloRecord (record);
+    }
   
   // Send HELLO over all interfaces
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
        i != m_socketAddresses.end (); ++i)
     {
-      Ptr<Socket> socket = i->first;
-      Ipv4InterfaceAddress iface = i->second;
-      
-      helloHeader.src = iface.GetLocal ();
-      
-      // Create and send packet
-      Ptr<Packet> packet = Create<Packet> ();
-      // Add DlarpHeader (would need proper serialization in real implementation)
-      
-      socket->SendTo (packet, 0, InetSocketAddress (Ipv4Address ("255.255.255.255"), 654));
+      SendTo (i->first, helloHeader, Ipv4Address::GetBroadcast ());
     }
-  
-  // Schedule next HELLO
-  Time jitter = Seconds (m_uniformRandomVariable->GetValue (0, 0.1));
-  m_helloTimer.Schedule (m_helloInterval + jitter);
 }
 
 void
-DlarpRoutingProtocol::RecvDlarp (Ptr<Socket> socket)
+DlarpRoutingProtocol::HelloTimerFire ()
 {
-  NS_LOG_FUNCTION (this << socket);
-  
-  Ptr<Packet> packet;
-  Address sourceAddress;
+  NS_LOG_FUNCTION (this);
   
-  while ((packet = socket->RecvFrom (sourceAddress)))
+  if (!m_adaptiveHello)
     {
-      InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
-      Ipv4Address sender = inetSourceAddr.GetIpv4 ();
+      SendHello ();
+    }
+  else
+    {
+      Time now = Simulator::Now ();
       
-      // Extract header (would need proper deserialization in real implementation)
-      DlarpHeader header;
-      // packet->RemoveHeader (header)
+      // Halve the interval on high churn, double it on a stable neighborhood
+      double churn = double (m_neighborChurn) / std::max<size_t> (1, m_neighborTable.size ());
+      Time maxInterval = Min (m_maxHelloInterval, m_neighborTimeout / 2);
+      if (churn > m_helloChurnThreshold)
+        {
+          m_currentHelloInterval = Max (m_currentHelloInterval / 2, m_minHelloInterval);
+        }
+      else if (m_neighborChurn == 0)
+        {
+          m_currentHelloInterval = Min (m_currentHelloInterval * 2, maxInterval);
+        }
+      m_neighborChurn = 0;
       
-      // Process based on packet type
-      switch (header.type)
+      // A DLARP broadcast within the interval already acted as a HELLO
+      if (now - m_lastBcastTime >= m_currentHelloInterval)
         {
-        case DLARPTYPE_HELLO:
-          // Update neighbor table
-          m_neighborTable[header.src] = Simulator::Now () + m_neighborTimeout;
-          break;
-          
-        case DLARPTYPE_RREQ:
-          // Process route request
-          // Implement route request handling
-          break;
-          
-        case DLARPTYPE_RREP:
-          // Process route reply
-          // Implement route reply handling
-          break;
-          
-        case DLARPTYPE_AGREEMENT:
-          // Process local agreement message
-          // Implement agreement handling
-          break;
-          
-        default:
-          NS_LOG_WARN ("Unknown DLARP packet type received");
-          break;
+          SendHello ();
         }
+      NS_LOG_LOGIC ("HELLO interval " << m_currentHelloInterval.As (Time::S) << ", churn " << churn);
     }
-}
-
-Ptr<Ipv4Route>
-DlarpRoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
-{
-  NS_LOG_FUNCTION (this << header);
   
-  Ipv4Address dst = header.GetDestination ();
+  if (m_authentication)
+    {
+      m_sessions.Purge ();
+    }
   
-  // Check if we have a route to the destination
-  std::map<Ipv4Address, std::vector<DlarpRoutingTableEntry> >::iterator it = m_routingTable.find (dst);
-  if (it != m_routingTable.end () && !it->second.empty ())
-    {
-      // Sort by metric to get the best route
-      std::sort (it->second.begin (), it->second.end (),
-                 [](const DlarpRoutingTableEntry &a, const DlarpRoutingTableEntry &b) {
-                   return a.GetMetric () < b.GetMetric ();
-                 });
-      
-      DlarpRoutingTableEntry entry = it->second.front ();
-      if (entry.GetLifeTime () > Simulator::Now ())
+  // The buffer only drops its expired packets by itself when it is used
+  std::vector<DlarpRequestQueue::Entry> expired;
+  m_queue.DropExpired (expired);
+  DropPackets (expired);
+  
+  // Forget the old broken routes
+  for (std::map<Ipv4Address, Time>::iterator it = m_brokenRoutes.begin (); it != m_brokenRoutes.end (); )
+    {
+      if (it->second <= Simulator::Now ())
+        {
+          m_brokenRoutes.erase (it++);
+        }
+      else
         {
-          // Valid route exists
-          Ptr<Ipv4Route> route = Create<Ipv4Route> ();
-          route->SetDestination (dst);
-          route->SetGateway (entry.GetNextHop ());
-          route->SetOutputDevice (m_ipv4->GetNetDevice (entry.GetInterface ()));
-          route->SetSource (m_ipv4->GetAddress (entry.GetInterface (), 0).GetLocal ());
-          return route;
+          ++it;
         }
     }
   
-  // No route found, initiate route discovery
-  SendRouteRequest (dst);
-  
-  // Return error for now
-  sockerr = Socket::ERROR_NOROUTETOHOST;
-  return NULL;
+  // Schedule next HELLO
+  Time jitter = Seconds (m_uniformRandomVariable->GetValue (0, 0.1));
+  m_helloTimer.Schedule (m_currentHelloInterval + jitter);
 }
 
-bool
-DlarpRoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
-                                 UnicastForwardCallback ucb, MulticastForwardCallback mcb,
-                                 LocalDeliverCallback lcb, ErrorCallback ecb)
+void
+DlarpRoutingProtocol::UpdateNeighbor (Ipv4Address neighbor)
 {
-  NS_LOG_FUNCTION (this << p << header << idev);
-  
-  Ipv4Address dst = header.GetDestination ();
-  Ipv4Address src = header.GetSource ();
-  
-  // If the packet is destined for this node, deliver locally
-  for (uint32_t i = 0; i < m_ipv4->GetNInterfaces (); i++)
+  Time expire = Simulator::Now () + m_neighborTimeout;
+  NeighborEntry entry;
+  entry.expire = expire;
+  entry.link = DlarpLinkEstimator (m_etxWindow);
+  std::pair<std::map<Ipv4Address, NeighborEntry>::iterator, bool> result =
+    m_neighborTable.insert (std::make_pair (neighbor, entry));
+  if (result.second)
     {
-      if (m_ipv4->GetAddress (i, 0).GetLocal () == dst)
-        {
-          return lcb (p, header, 0);
-        }
+      m_neighborChurn++;
+      ScheduleExpiry (DlarpTimerWheel::NEIGHBOR, neighbor, expire);
     }
-  
-  // Check if we have a route to forward the packet
-  std::map<Ipv4Address, std::vector<DlarpRoutingTableEntry> >::iterator it = m_routingTable.find (dst);
-  if (it != m_routingTable.end () && !it->second.empty ())
-    {
-      // Sort by metric to get the best route
-      std::sort (it->second.begin (), it->second.end (),
-                 [](const DlarpRoutingTableEntry &a, const DlarpRoutingTableEntry &b) {
-                   return a.GetMetric () < b.GetMetric ();
-                 });
-      
-      DlarpRoutingTableEntry entry = it->second.front ();
-      if (entry.GetLifeTime () > Simulator::Now ())
-        {
-          // Valid route exists, forward the packet
-          Ptr<Ipv4Route> route = Create<Ipv4Route> ();
-          route->SetDestination (dst);
-          route->SetGateway (entry.GetNextHop ());
-          route->SetOutputDevice (m_ipv4->GetNetDevice (entry.GetInterface ()));
-          route->SetSource (m_ipv4->GetAddress (entry.GetInterface (), 0).GetLocal ());
-          ucb (route, p, header);
-          return true;
+  else
+    {
+      result.first->second.expire = expire;
+    }
+}
+
+void
+DlarpRoutingProtocol::RecvHello (const DlarpHeader &helloHeader, Ipv4Address sender)
+{
+  std::map<Ipv4Address, NeighborEntry>::iterator nb = m_neighborTable.find (sender);
+  NS_ASSERT (nb != m_neighborTable.end ());
+  DlarpLinkEstimator &link = nb->second.link;
+  link.RecvHello (helloHeader.GetSeqNo ());
+  for (uint32_t i = 0; i < helloHeader.GetNHelloRecords (); ++i)
+    {
+      const DlarpHelloRecord &record = helloHeader.GetHelloRecord (i);
+      if (IsMyOwnAddress (record.neighbor))
+        {
+          link.SetForwardRatio (record.ratio);
+          break;
         }
     }
-  
-  // No route found, drop the packet
-  return ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+  // Keep the one-hop route in step with the link; longer routes pick up
+  // the new ETX at their next discovery or agreement
+  m_routingTable.SetMetric (sender, sender, link.GetEtx ());
 }
 
-// Implementation of DLARP-specific methods
+bool
+DlarpRoutingProtocol::InstallRoute (const DlarpRoutingTableEntry &entry)
+{
+  bool known = (m_routingTable.GetCandidates (entry.GetDestination ()) != 0);
+  bool changed = m_routingTable.AddRoute (entry);
+  if (!known)
+    {
+      ScheduleExpiry (DlarpTimerWheel::ROUTE, entry.GetDestination (), entry.GetLifeTime ());
+      m_tableSize = m_routingTable.GetNDestinations ();
+    }
+  return changed;
+}
 
 void
-DlarpRoutingProtocol::SendRouteRequest (Ipv4Address dst)
+DlarpRoutingProtocol::ScheduleExpiry (DlarpTimerWheel::Kind kind, Ipv4Address address, Time expire)
 {
-  NS_LOG_FUNCTION (this << dst);
-  
-  // Prepare a RREQ packet
-  DlarpHeader rreqHeader;
-  rreqHeader.type = DLARPTYPE_RREQ;
-  rreqHeader.seqNo = ++m_seqNo;
-  rreqHeader.requestId = ++m_requestId;
-  rreqHeader.dst = dst;
-  rreqHeader.hopCount = 0;
-  
-  // Broadcast RREQ over all interfaces
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
-       i != m_socketAddresses.end (); ++i)
+  int64_t granularity = m_expiryGranularity.GetTimeStep ();
+  if (m_expiryWheel.IsEmpty () && !m_expiryEvent.IsRunning ())
     {
-      Ptr<Socket> socket = i->first;
-      Ipv4InterfaceAddress iface = i->second;
-      
-      rreqHeader.src = iface.GetLocal ();
-      
-      // Create and send packet
-      Ptr<Packet> packet = Create<Packet> ();
-      // Add DlarpHeader (would need proper serialization in real implementation)
-      
-      socket->SendTo (packet, 0, InetSocketAddress (Ipv4Address ("255.255.255.255"), 654));
+      // The wheel stops while idle: catch up with the current time
+      m_expiryWheel.SetCurrentTick (Simulator::Now ().GetTimeStep () / granularity);
+    }
+  m_expiryWheel.Insert ((expire.GetTimeStep () + granularity - 1) / granularity, kind, address);
+  if (!m_expiryEvent.IsRunning ())
+    {
+      Time next = TimeStep ((m_expiryWheel.GetCurrentTick () + 1) * granularity);
+      m_expiryEvent = Simulator::Schedule (next - Simulator::Now (), &DlarpRoutingProtocol::HelloTimerExpire, this);
     }
 }
 
 void
-DlarpRoutingProtocol::PerformLocalAgreement (Ipv4Address dst)
+DlarpRoutingProtocol::HelloTimerExpire ()
 {
-  NS_LOG_FUNCTION (this << dst);
+  std::vector<DlarpTimerWheel::Timer> due;
+  m_expiryWheel.Advance (due);
+  
+  // Copies of one timer fire together: handle every address once
+  std::sort (due.begin (), due.end (),
+             [](const DlarpTimerWheel::Timer &a, const DlarpTimerWheel::Timer &b) {
+               return a.kind < b.kind || (a.kind == b.kind && a.address < b.address);
+             });
+  due.erase (std::unique (due.begin (), due.end (),
+                          [](const DlarpTimerWheel::Timer &a, const DlarpTimerWheel::Timer &b) {
+                            return a.kind == b.kind && a.address == b.address;
+                          }),
+             due.end ());
+  
+  Time now = Simulator::Now ();
+  std::set<Ipv4Address> lostNeighbors;
+  for (std::vector<DlarpTimerWheel::Timer>::const_iterator i = due.begin (); i != due.end (); ++i)
+    {
+      if (i->kind == DlarpTimerWheel::NEIGHBOR)
+        {
+          std::map<Ipv4Address, NeighborEntry>::iterator nb = m_neighborTable.find (i->address);
+          if (nb == m_neighborTable.end ())
+            {
+              continue;
+            }
+          if (nb->second.expire > now)
+            {
+              // Refreshed since the timer was set
+              ScheduleExpiry (DlarpTimerWheel::NEIGHBOR, i->address, nb->second.expire);
+              continue;
+            }
+          m_neighborTable.erase (nb);
+          m_neighborChurn++;
+          lostNeighbors.insert (i->address);
+        }
+      else
+        {
+          Time nextExpiry;
+          if (m_routingTable.Purge (i->address, nextExpiry))
+            {
+              ScheduleExpiry (DlarpTimerWheel::ROUTE, i->address, nextExpiry);
+            }
+        }
+    }
   
-  // Implementation of DLARP's local agreement phase
-  // This is where the core of DLARP's algorithm would go
+  if (!lostNeighbors.empty ())
+    {
+      LoseNeighbors (lostNeighbors);
+    }
+  m_tableSize = m_routingTable.GetNDestinations ();
   
-  // For example:
-  // 1. Collect routing information from neighbors
-  // 2. Apply consensus algorithm to determine best path
-  // 3. Update routing table based on agreement
+  if (!m_expiryWheel.IsEmpty () && !m_expiryEvent.IsRunning ())
+    {
+      m_expiryEvent = Simulator::Schedule (m_expiryGranularity, &DlarpRoutingProtocol::HelloTimerExpire, this);
+    }
 }
 
 void
-DlarpRoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+DlarpRoutingProtocol::LoseNeighbors (const std::set<Ipv4Address> &lostNeighbors)
 {
-  *stream->GetStream () << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
-                        << ", DLARP Routing table:" << std::endl;
-                        
-  *stream->GetStream () << "Destination\tNextHop\tInterface\tSeqNo\tMetric\tLifetime" << std::endl;
+  for (std::set<Ipv4Address>::const_iterator i = lostNeighbors.begin (); i != lostNeighbors.end (); ++i)
+    {
+      m_sessions.NeighborLost (*i, m_sessionResumption);
+      m_keys.Remove (*i);
+    }
   
-  for (std::map<Ipv4Address, std::vector<DlarpRoutingTableEntry> >::const_iterator i = m_routingTable.begin ();
-       i != m_routingTable.end (); ++i)
+  // Routes through a lost neighbor go with it, in one pass over the table
+  std::vector<std::pair<Ipv4Address, Time> > unreachable;
+  m_routingTable.DeleteRoutesVia (lostNeighbors, unreachable);
+  m_tableSize = m_routingTable.GetNDestinations ();
+  NS_LOG_LOGIC (lostNeighbors.size () << " neighbors lost, " << unreachable.size ()
+                << " destinations lost");
+  
+  // Rediscover at once the destinations this node still sends data to,
+  // instead of waiting for their next packet; the others may be repaired
+  // here when data to them comes in
+  Time now = Simulator::Now ();
+  for (std::vector<std::pair<Ipv4Address, Time> >::const_iterator i = unreachable.begin ();
+       i != unreachable.end (); ++i)
     {
-      for (std::vector<DlarpRoutingTableEntry>::const_iterator j = i->second.begin ();
-           j != i->second.end (); ++j)
+      if (!i->second.IsZero () && now - i->second < m_routeTimeout)
+        {
+          StartRouteDiscovery (i->first);
+        }
+      else if (m_localRepair)
         {
-          *stream->GetStream () << i->first << "\t"
-                                << j->GetNextHop () << "\t"
-                                << j->GetInterface () << "\t"
-                                << j->GetSeqNo () << "\t"
-                                << j->GetMetric () << "\t"
-                                << (j->GetLifeTime () - Simulator::Now ()).As (unit) << std::endl;
+          m_brokenRoutes[i->first] = now + m_routeTimeout;
         }
     }
 }
 
-// RoutingTableEntry implementation
-
-DlarpRoutingTableEntry::DlarpRoutingTableEntry () :
-  m_seqNo (0),
-  m_metric (0)
-{
-}
-
-DlarpRoutingTableEntry::DlarpRoutingTableEntry (Ipv4Address dst, Ipv4Address nextHop, uint32_t interface, uint32_t seqNo) :
-  m_destination (dst),
-  m_nextHop (nextHop),
-  m_interface (interface),
-  m_seqNo (seqNo),
-  m_lifeTime (Simulator::Now ()),
-  m_metric (0)
-{
-}
-
-Ipv4Address
-DlarpRoutingTableEntry::GetDestination () const
+void
+DlarpRoutingProtocol::BreakLink (Ipv4Address neighbor)
 {
-  return m_destination;
+  std::map<Ipv4Address, NeighborEntry>::iterator nb = m_neighborTable.find (neighbor);
+  if (nb == m_neighborTable.end ())
+    {
+      // Already lost, or only a route through a stale ARP entry
+      return;
+    }
+  NS_LOG_LOGIC ("Link with " << neighbor << " broken");
+  m_neighborTable.erase (nb);
+  m_neighborChurn++;
+  m_stats.linkBreaks++;
+  std::set<Ipv4Address> lostNeighbors;
+  lostNeighbors.insert (neighbor);
+  LoseNeighbors (lostNeighbors);
 }
 
-Ipv4Address
-DlarpRoutingTableEntry::GetNextHop () const
+void
+DlarpRoutingProtocol::ConnectLinkLayerFeedback (uint32_t interface)
 {
-  return m_nextHop;
+  Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (m_ipv4->GetNetDevice (interface));
+  if (!m_linkLayerFeedback || wifi == 0 || !m_feedbackDevices.insert (wifi).second)
+    {
+      return;
+    }
+  // The station manager reports the frames whose retransmissions ran out,
+  // the MAC the MPDUs dropped at the retry limit, aggregates included
+  wifi->GetRemoteStationManager ()->TraceConnectWithoutContext (
+    "MacTxFinalDataFailed", MakeCallback (&DlarpRoutingProtocol::NotifyTxFailed, this));
+  wifi->GetMac ()->TraceConnectWithoutContext (
+    "DroppedMpdu", MakeCallback (&DlarpRoutingProtocol::NotifyDroppedMpdu, this));
 }
 
-uint32_t
-DlarpRoutingTableEntry::GetInterface () const
+void
+DlarpRoutingProtocol::NotifyTxFailed (Mac48Address address)
 {
-  return m_interface;
+  NS_LOG_FUNCTION (this << address);
+  
+  // The neighbors behind a MAC address are found in the ARP caches
+  Ptr<Ipv4L3Protocol> l3 = DynamicCast<Ipv4L3Protocol> (m_ipv4);
+  if (l3 == 0)
+    {
+      return;
+    }
+  std::set<Ipv4Address> neighbors;
+  for (uint32_t i = 0; i < l3->GetNInterfaces (); ++i)
+    {
+      Ptr<ArpCache> arp = l3->GetInterface (i)->GetArpCache ();
+      if (arp == 0)
+        {
+          continue;
+        }
+      std::list<ArpCache::Entry *> entries = arp->LookupInverse (address);
+      for (std::list<ArpCache::Entry *>::const_iterator e = entries.begin (); e != entries.end (); ++e)
+        {
+          neighbors.insert ((*e)->GetIpv4Address ());
+        }
+    }
+  for (std::set<Ipv4Address>::const_iterator i = neighbors.begin (); i != neighbors.end (); ++i)
+    {
+      BreakLink (*i);
+    }
 }
 
-uint32_t
-DlarpRoutingTableEntry::GetSeqNo () const
+void
+DlarpRoutingProtocol::NotifyDroppedMpdu (WifiMacDropReason reason, Ptr<const WifiMacQueueItem> mpdu)
 {
-  return m_seqNo;
+  if (reason == WIFI_MAC_DROP_REACHED_RETRY_LIMIT && mpdu->GetHeader ().IsData ())
+    {
+      NotifyTxFailed (mpdu->GetHeader ().GetAddr1 ());
+    }
 }
 
-Time
-DlarpRoutingTableEntry::GetLifeTime () const
+void
+DlarpRoutingProtocol::RecvDlarp (Ptr<Socket> socket)
 {
-  return m_lifeTime;
+  NS_LOG_FUNCTION (this << socket);
+  
+  Ptr<Packet> packet;
+  Address sourceAddress;
+  
+  while ((packet = socket->RecvFrom (sourceAddress)))
+    {
+      InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
+      Ipv4Address sender = inetSourceAddr.GetIpv4 ();
+      std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator receiver = m_socketAddresses.find (socket);
+      if (receiver == m_socketAddresses.end ())
+        {
+          continue;
+        }
+      uint32_t interface = m_ipv4->GetInterfaceForAddress (receiver->second.GetLocal ());
+      
+      m_stats.rxDatagrams++;
+      
+      // The MACs cover the bytes of their message as received
+      uint32_t offset = 0;
+      if (m_controlMac)
+        {
+          m_macScratch.resize (packet->GetSize ());
+          packet->CopyData (m_macScratch.data (), m_macScratch.size ());
+        }
+      
+      // A datagram carries one or more messages back to back
+      while (packet->GetSize () > 0)
+        {
+          // Extract header; fields are parsed in place from the packet buffer
+          DlarpHeader header;
+          uint32_t size = packet->GetSize ();
+          packet->RemoveHeader (header);
+          if (!header.IsValid () || (m_controlMac && packet->GetSize () < m_macSize))
+            {
+              NS_LOG_WARN ("Unknown or truncated DLARP message received");
+              m_stats.rxInvalid++;
+              break;
+            }
+          size -= packet->GetSize ();
+          bool authentic = true;
+          if (m_controlMac)
+            {
+              uint64_t mac = DlarpKeyTable::ComputeMac (m_keys.GetKey (sender), &m_macScratch[offset], size);
+              for (uint32_t i = 0; i < m_macSize; ++i)
+                {
+                  authentic &= (m_macScratch[offset + size + i] == uint8_t (mac >> (56 - 8 * i)));
+                }
+              packet->RemoveAtStart (m_macSize);
+              size += m_macSize;
+              offset += size;
+            }
+          NS_LOG_DEBUG ("Received " << header << " from " << sender);
+          
+          if (!m_controlMac)
+            {
+              ProcessMessage (header, sender, interface);
+              continue;
+            }
+          PendingMessage message;
+          message.header = header;
+          message.sender = sender;
+          message.interface = interface;
+          message.authentic = authentic;
+          message.arrival = Simulator::Now ();
+          QueueVerification (message);
+        }
+    }
 }
 
-double
-DlarpRoutingTableEntry::GetMetric () const
+void
+DlarpRoutingProtocol::ProcessMessage (const DlarpHeader &header, Ipv4Address sender, uint32_t interface)
 {
-  return m_metric;
+  // Counted when processed: a message whose MAC fails only counts in macFailures
+  m_stats.rxPackets[header.GetType ()]++;
+  m_stats.rxBytes[header.GetType ()] += header.GetSerializedSize () + (m_controlMac ? m_macSize : 0);
+  m_rxTrace (header, sender);
+  
+  // Any DLARP message proves the sender is a neighbor
+  UpdateNeighbor (sender);
+  
+  // Process based on packet type
+  switch (header.GetType ())
+    {
+    case DLARPTYPE_HELLO:
+      RecvHello (header, sender);
+      break;
+      
+    case DLARPTYPE_RREQ:
+      RecvRouteRequest (header, sender, interface);
+      break;
+      
+    case DLARPTYPE_RREP:
+      RecvRouteReply (header, sender, interface);
+      break;
+      
+    case DLARPTYPE_AGREEMENT:
+      UpdateRouteByLocalAgreement (header, sender, interface);
+      break;
+      
+    case DLARPTYPE_AUTH1:
+      RecvAuth1 (header, sender, interface);
+      break;
+      
+    case DLARPTYPE_AUTH2:
+      RecvAuth2 (header, sender);
+      break;
+      
+    case DLARPTYPE_AUTH3:
+      RecvAuth3 (header, sender);
+      break;
+      
+    case DLARPTYPE_RERR:
+      RecvRouteError (header, sender);
+      break;
+      
+    default:
+      NS_LOG_WARN ("Unknown DLARP packet type received");
+      break;
+    }
 }
 
 void
-DlarpRoutingTableEntry::SetLifeTime (Time lifeTime)
+DlarpRoutingProtocol::QueueVerification (const PendingMessage &message)
 {
-  m_lifeTime = lifeTime;
+  if (m_macBatchInterval.IsZero ())
+    {
+      StartVerification (std::vector<PendingMessage> (1, message));
+      return;
+    }
+  m_macPending.push_back (message);
+  if (!m_macBatchEvent.IsRunning ())
+    {
+      // Ticks are aligned on multiples of the interval
+      int64_t interval = m_macBatchInterval.GetTimeStep ();
+      Time tick = TimeStep ((Simulator::Now ().GetTimeStep () / interval + 1) * interval);
+      m_macBatchEvent = Simulator::Schedule (tick - Simulator::Now (), &DlarpRoutingProtocol::MacBatchTick, this);
+    }
 }
 
 void
-DlarpRoutingTableEntry::SetMetric (double metric)
+DlarpRoutingProtocol::MacBatchTick ()
 {
-  m_metric = metric;
+  NS_LOG_FUNCTION (this << m_macPending.size ());
+  std::vector<PendingMessage> batch;
+  batch.swap (m_macPending);
+  StartVerification (batch);
 }
 
 void
-DlarpRoutingTableEntry::SetNextHop (Ipv4Address nextHop)
+DlarpRoutingProtocol::StartVerification (const std::vector<PendingMessage> &batch)
 {
-  m_nextHop = nextHop;
+  // The verifications of a node run one after the other on its CPU
+  Time start = std::max (Simulator::Now (), m_cpuBusyUntil);
+  m_cpuBusyUntil = start + m_macBatchCost + m_macMessageCost * int64_t (batch.size ());
+  m_stats.macBatches++;
+  Simulator::Schedule (m_cpuBusyUntil - Simulator::Now (), &DlarpRoutingProtocol::FinishVerification, this, batch);
 }
 
 void
-DlarpRoutingTableEntry::SetInterface (uint32_t interface)
+DlarpRoutingProtocol::FinishVerification (std::vector<PendingMessage> batch)
 {
-  m_interface = interface;
+  for (std::vector<PendingMessage>::const_iterator i = batch.begin (); i != batch.end (); ++i)
+    {
+      m_stats.macVerified++;
+      m_stats.macDelay += Simulator::Now () - i->arrival;
+      if (!i->authentic)
+        {
+          NS_LOG_WARN ("Wrong MAC on " << i->header << " from " << i->sender);
+          m_stats.macFailures++;
+          continue;
+        }
+      ProcessMessage (i->header, i->sender, i->interface);
+    }
 }
 
-void
-DlarpRoutingTableEntry::SetSeqNo (uint32_t seqNo)
+Ptr<Ipv4Route>
+DlarpRoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
 {
-  m_seqNo = seqNo;
+  NS_LOG_FUNCTION (this << header);
+  
+  Ipv4Address dst = header.GetDestination ();
+  
+  // DLARP messages go straight to the neighbor, even before a session with it
+  DlarpControlTag control;
+  if (p != 0 && oif != 0 && p->PeekPacketTag (control))
+    {
+      uint32_t interface = m_ipv4->GetInterfaceForDevice (oif);
+      Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+      route->SetDestination (dst);
+      route->SetGateway (dst);
+      route->SetOutputDevice (oif);
+      route->SetSource (m_ipv4->GetAddress (interface, 0).GetLocal ());
+      return route;
+    }
+  
+  // Check if we have a route to the destination
+  DlarpRoutingTableEntry *entry = LookupRoute (header);
+  m_lookupTrace (dst, entry != 0);
+  if (entry != 0)
+    {
+      // Valid route exists
+      m_stats.routeHits++;
+      entry->SetLastUsed (Simulator::Now ());
+      if (HasSession (entry, dst))
+        {
+          return GetCachedRoute (entry);
+        }
+      // Hold the packet until the next hop is authenticated
+      sockerr = Socket::ERROR_NOTERROR;
+      return LoopbackRoute (header, oif);
+    }
+  m_stats.routeMisses++;
+  
+  // A destination recently found unreachable fails at once
+  if (IsUnreachable (dst) || m_socketAddresses.empty ())
+    {
+      if (p != 0)
+        {
+          NotifyDrop (p, header, m_socketAddresses.empty () ? DlarpStats::DROP_NO_ROUTE
+                                                            : DlarpStats::DROP_UNREACHABLE);
+        }
+      sockerr = Socket::ERROR_NOROUTETOHOST;
+      return NULL;
+    }
+  
+  // No route found: initiate route discovery unless one is already running,
+  // and hold the packet in the send buffer, through the loopback device,
+  // until it completes
+  StartRouteDiscovery (dst);
+  sockerr = Socket::ERROR_NOTERROR;
+  return LoopbackRoute (header, oif);
+}
+
+bool
+DlarpRoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                                 UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                                 LocalDeliverCallback lcb, ErrorCallback ecb)
+{
+  NS_LOG_FUNCTION (this << p << header << idev);
+  
+  Ipv4Address dst = header.GetDestination ();
+  Ipv4Address src = header.GetSource ();
+  
+  // If the packet is destined for this node, deliver locally
+  if (m_localAddresses.find (dst) != m_localAddresses.end ())
+    {
+      if (lcb.IsNull ())
+        {
+          ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+          return false;
+        }
+      lcb (p, header, m_ipv4->GetInterfaceForDevice (idev));
+      return true;
+    }
+  
+  // Packets of this node that wait for a route come back through loopback
+  if (idev == m_lo)
+    {
+      DeferRouteOutput (p, header, ucb, ecb);
+      return true;
+    }
+  
+  // Check if we have a route to forward the packet
+  DlarpRoutingTableEntry *entry = LookupRoute (header);
+  m_lookupTrace (dst, entry != 0);
+  if (entry != 0)
+    {
+      // Valid route exists, forward the packet
+      m_stats.routeHits++;
+      if (HasSession (entry, dst))
+        {
+          ucb (GetCachedRoute (entry), p, header);
+        }
+      else
+        {
+          DeferRouteOutput (p, header, ucb, ecb);
+        }
+      return true;
+    }
+  m_stats.routeMisses++;
+  
+  // The route broke here: hold the packet while it is repaired locally
+  std::map<Ipv4Address, Time>::const_iterator broken = m_brokenRoutes.find (dst);
+  if (broken != m_brokenRoutes.end () && broken->second > Simulator::Now ())
+    {
+      StartLocalRepair (dst);
+      DeferRouteOutput (p, header, ucb, ecb);
+      return true;
+    }
+  
+  // No route found, drop the packet
+  NotifyDrop (p, header, DlarpStats::DROP_NO_ROUTE);
+  ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+  return false;
+}
+
+// Implementation of DLARP-specific methods
+
+Ptr<Ipv4Route>
+DlarpRoutingProtocol::LoopbackRoute (const Ipv4Header &header, Ptr<NetDevice> oif) const
+{
+  Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+  route->SetDestination (header.GetDestination ());
+  // Source address of the requested output device, or of the first DLARP interface
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
+       i != m_socketAddresses.end (); ++i)
+    {
+      Ipv4Address address = i->second.GetLocal ();
+      if (oif == 0 || m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (address)) == oif)
+        {
+          route->SetSource (address);
+          break;
+        }
+    }
+  route->SetGateway (Ipv4Address ("127.0.0.1"));
+  route->SetOutputDevice (m_lo);
+  return route;
+}
+
+void
+DlarpRoutingProtocol::DeferRouteOutput (Ptr<const Packet> p, const Ipv4Header &header,
+                                        UnicastForwardCallback ucb, ErrorCallback ecb)
+{
+  NS_LOG_FUNCTION (this << p << header);
+  
+  // The route may have appeared while the packet went through loopback
+  Ipv4Address dst = header.GetDestination ();
+  DlarpRoutingTableEntry *entry = LookupRoute (header);
+  if (entry != 0 && HasSession (entry, dst))
+    {
+      ucb (GetCachedRoute (entry), p, header);
+      return;
+    }
+  // ... or its discovery may have failed
+  if (entry == 0 && IsUnreachable (dst))
+    {
+      NotifyDrop (p, header, DlarpStats::DROP_UNREACHABLE);
+      ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+      return;
+    }
+  
+  DlarpRequestQueue::Entry queued;
+  queued.packet = p;
+  queued.header = header;
+  queued.ucb = ucb;
+  queued.ecb = ecb;
+  // Set by the queue too; tells a packet refused by a full queue from an expired one
+  queued.expire = Simulator::Now () + m_queue.GetTimeout ();
+  std::vector<DlarpRequestQueue::Entry> dropped;
+  m_queue.Enqueue (queued, dropped);
+  DropPackets (dropped);
+  // A packet waiting for a session is sent when the handshake ends
+  if (entry == 0 && m_queue.Find (dst))
+    {
+      StartRouteDiscovery (dst);
+    }
+}
+
+void
+DlarpRoutingProtocol::SendPacketsFromQueue (Ipv4Address dst)
+{
+  std::vector<DlarpRequestQueue::Entry> entries;
+  std::vector<DlarpRequestQueue::Entry> dropped;
+  m_queue.Dequeue (dst, entries, dropped);
+  DropPackets (dropped);
+  dropped.clear ();
+  if (entries.empty ())
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("Sending " << entries.size () << " buffered packets to " << dst);
+  for (std::vector<DlarpRequestQueue::Entry>::const_iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      DlarpRoutingTableEntry *entry = LookupRoute (i->header);
+      if (entry == 0)
+        {
+          NotifyDrop (i->packet, i->header, DlarpStats::DROP_NO_ROUTE);
+          i->ecb (i->packet, i->header, Socket::ERROR_NOROUTETOHOST);
+          continue;
+        }
+      if (!HasSession (entry, dst))
+        {
+          // The route goes through a neighbor not authenticated yet
+          m_queue.Enqueue (*i, dropped);
+          continue;
+        }
+      i->ucb (GetCachedRoute (entry), i->packet, i->header);
+    }
+  DropPackets (dropped);
+}
+
+void
+DlarpRoutingProtocol::DropPackets (const std::vector<DlarpRequestQueue::Entry> &dropped,
+                                   DlarpStats::DropReason reason)
+{
+  Time now = Simulator::Now ();
+  for (std::vector<DlarpRequestQueue::Entry>::const_iterator i = dropped.begin (); i != dropped.end (); ++i)
+    {
+      NS_LOG_LOGIC ("Dropping buffered packet " << i->packet->GetUid () << " to " << i->header.GetDestination ());
+      NotifyDrop (i->packet, i->header, i->expire <= now ? DlarpStats::DROP_QUEUE_TIMEOUT : reason);
+      i->ecb (i->packet, i->header, Socket::ERROR_NOROUTETOHOST);
+    }
+}
+
+void
+DlarpRoutingProtocol::NotifyDrop (Ptr<const Packet> p, const Ipv4Header &header, DlarpStats::DropReason reason)
+{
+  m_stats.drops[reason]++;
+  m_dropTrace (p, header, reason);
+}
+
+Ptr<Ipv4Route>
+DlarpRoutingProtocol::GetCachedRoute (DlarpRoutingTableEntry *entry)
+{
+  Ptr<Ipv4Route> route = entry->GetRoute ();
+  if (route == 0)
+    {
+      route = Create<Ipv4Route> ();
+      route->SetDestination (entry->GetDestination ());
+      route->SetGateway (entry->GetNextHop ());
+      route->SetOutputDevice (m_ipv4->GetNetDevice (entry->GetInterface ()));
+      route->SetSource (m_ipv4->GetAddress (entry->GetInterface (), 0).GetLocal ());
+      entry->SetRoute (route);
+    }
+  return route;
+}
+
+DlarpRoutingTableEntry *
+DlarpRoutingProtocol::LookupRoute (const Ipv4Header &header)
+{
+  if (!m_enableMultipath)
+    {
+      return m_routingTable.LookupRoute (header.GetDestination ());
+    }
+  return m_routingTable.LookupRoute (header.GetDestination (), GetFlowHash (header));
+}
+
+uint32_t
+DlarpRoutingProtocol::GetFlowHash (const Ipv4Header &header)
+{
+  // FNV-1a over source, destination and protocol
+  uint32_t hash = 2166136261u;
+  uint8_t tuple[9];
+  header.GetSource ().Serialize (tuple);
+  header.GetDestination ().Serialize (tuple + 4);
+  tuple[8] = header.GetProtocol ();
+  for (uint32_t i = 0; i < sizeof (tuple); ++i)
+    {
+      hash ^= tuple[i];
+      hash *= 16777619u;
+    }
+  return hash;
+}
+
+void
+DlarpRoutingProtocol::SendRouteRequest (Ipv4Address dst, uint8_t ttl)
+{
+  NS_LOG_FUNCTION (this << dst << (uint32_t) ttl);
+  
+  // Prepare a RREQ packet
+  DlarpHeader rreqHeader (DLARPTYPE_RREQ);
+  rreqHeader.SetSeqNo (++m_seqNo);
+  rreqHeader.SetRequestId (++m_requestId);
+  rreqHeader.SetDst (dst);
+  rreqHeader.SetHopCount (0);
+  rreqHeader.SetTtl (ttl);
+  rreqHeader.SetMetric (0);
+  
+  // Broadcast RREQ over all interfaces
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
+       i != m_socketAddresses.end (); ++i)
+    {
+      Ptr<Socket> socket = i->first;
+      Ipv4InterfaceAddress iface = i->second;
+      
+      rreqHeader.SetSrc (iface.GetLocal ());
+      SendTo (socket, rreqHeader, Ipv4Address::GetBroadcast ());
+    }
+}
+
+void
+DlarpRoutingProtocol::RecvRouteRequest (const DlarpHeader &rreqHeader, Ipv4Address sender, uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << sender << rreqHeader.GetSrc () << rreqHeader.GetRequestId ());
+  
+  Ipv4Address origin = rreqHeader.GetSrc ();
+  if (IsMyOwnAddress (origin))
+    {
+      return;
+    }
+  
+  // Duplicate: count it as one more neighbor relaying the request
+  DlarpIdCache::Entry *seen = m_rreqIdCache.Lookup (origin, rreqHeader.GetRequestId ());
+  if (seen != 0)
+    {
+      seen->count++;
+      if (m_rreqSuppressionThreshold > 0 && seen->count >= m_rreqSuppressionThreshold
+          && seen->rebroadcast.IsRunning ())
+        {
+          NS_LOG_LOGIC ("Suppressing rebroadcast of RREQ " << origin << "/" << rreqHeader.GetRequestId ()
+                        << " after " << seen->count << " copies");
+          seen->rebroadcast.Cancel ();
+        }
+      return;
+    }
+  if (m_rreqIdCache.IsFull ())
+    {
+      NS_LOG_WARN ("Duplicate RREQ cache full: forgetting a live request");
+      m_stats.rreqIdOverwrites++;
+    }
+  seen = m_rreqIdCache.Insert (origin, rreqHeader.GetRequestId ());
+  
+  Time lifeTime = Simulator::Now () + m_routeTimeout;
+  
+  // The sender is a neighbor: keep a one-hop route to it
+  DlarpRoutingTableEntry toSender (sender, sender, interface, 0);
+  toSender.SetMetric (GetLinkMetric (sender));
+  toSender.SetLifeTime (lifeTime);
+  InstallRoute (toSender);
+  
+  // Reverse route towards the originator, used by the RREP
+  double metric = rreqHeader.GetMetric () + GetLinkMetric (sender);
+  DlarpRoutingTableEntry toOrigin (origin, sender, interface, rreqHeader.GetSeqNo ());
+  toOrigin.SetMetric (metric);
+  toOrigin.SetLifeTime (lifeTime);
+  if (InstallRoute (toOrigin))
+    {
+      PerformLocalAgreement (origin);
+    }
+  
+  if (IsMyOwnAddress (rreqHeader.GetDst ()))
+    {
+      SendRouteReply (origin, rreqHeader.GetDst (), ++m_seqNo);
+      return;
+    }
+  
+  if (rreqHeader.GetTtl () <= 1 || rreqHeader.GetHopCount () == std::numeric_limits<uint8_t>::max ())
+    {
+      return;
+    }
+  
+  DlarpHeader forward = rreqHeader;
+  forward.SetHopCount (rreqHeader.GetHopCount () + 1);
+  forward.SetTtl (rreqHeader.GetTtl () - 1);
+  forward.SetMetric (metric);
+  Time jitter = Seconds (m_uniformRandomVariable->GetValue (0, m_rreqRebroadcastJitter.GetSeconds ()));
+  seen->rebroadcast = Simulator::Schedule (jitter, &DlarpRoutingProtocol::RebroadcastRouteRequest, this, forward);
+}
+
+void
+DlarpRoutingProtocol::RebroadcastRouteRequest (DlarpHeader rreqHeader)
+{
+  NS_LOG_FUNCTION (this << rreqHeader.GetSrc () << rreqHeader.GetRequestId ());
+  
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
+       i != m_socketAddresses.end (); ++i)
+    {
+      SendTo (i->first, rreqHeader, Ipv4Address::GetBroadcast ());
+    }
+}
+
+void
+DlarpRoutingProtocol::SetRreqIdCacheSize (uint32_t size)
+{
+  m_rreqIdCache.SetCapacity (size);
+}
+
+uint32_t
+DlarpRoutingProtocol::GetRreqIdCacheSize () const
+{
+  return m_rreqIdCache.GetCapacity ();
+}
+
+void
+DlarpRoutingProtocol::SetRreqIdCacheLifetime (Time lifetime)
+{
+  m_rreqIdCache.SetLifetime (lifetime);
+}
+
+Time
+DlarpRoutingProtocol::GetRreqIdCacheLifetime () const
+{
+  return m_rreqIdCache.GetLifetime ();
+}
+
+void
+DlarpRoutingProtocol::SetSessionLifetime (Time lifetime)
+{
+  m_sessions.SetLifetime (lifetime);
+}
+
+Time
+DlarpRoutingProtocol::GetSessionLifetime () const
+{
+  return m_sessions.GetLifetime ();
+}
+
+void
+DlarpRoutingProtocol::SetMaxCandidates (uint32_t n)
+{
+  m_routingTable.SetMaxCandidates (n);
+}
+
+uint32_t
+DlarpRoutingProtocol::GetMaxCandidates () const
+{
+  return m_routingTable.GetMaxCandidates ();
+}
+
+void
+DlarpRoutingProtocol::SetMaxQueueLen (uint32_t len)
+{
+  m_queue.SetMaxPackets (len);
+}
+
+uint32_t
+DlarpRoutingProtocol::GetMaxQueueLen () const
+{
+  return m_queue.GetMaxPackets ();
+}
+
+void
+DlarpRoutingProtocol::SetMaxQueueBytes (uint32_t bytes)
+{
+  m_queue.SetMaxBytes (bytes);
+}
+
+uint32_t
+DlarpRoutingProtocol::GetMaxQueueBytes () const
+{
+  return m_queue.GetMaxBytes ();
+}
+
+void
+DlarpRoutingProtocol::SetMaxQueueTime (Time t)
+{
+  m_queue.SetTimeout (t);
+}
+
+Time
+DlarpRoutingProtocol::GetMaxQueueTime () const
+{
+  return m_queue.GetTimeout ();
+}
+
+void
+DlarpRoutingProtocol::SetQueueDropPolicy (DlarpRequestQueue::DropPolicy policy)
+{
+  m_queue.SetDropPolicy (policy);
+}
+
+DlarpRequestQueue::DropPolicy
+DlarpRoutingProtocol::GetQueueDropPolicy () const
+{
+  return m_queue.GetDropPolicy ();
+}
+
+void
+DlarpRoutingProtocol::StartRouteDiscovery (Ipv4Address dst)
+{
+  if (m_discoveries.find (dst) != m_discoveries.end ())
+    {
+      // Coalesce with the discovery in flight
+      return;
+    }
+  NS_LOG_FUNCTION (this << dst);
+  
+  DiscoveryEntry &discovery = m_discoveries[dst];
+  discovery.retries = 0;
+  discovery.start = Simulator::Now ();
+  discovery.localRepair = false;
+  if (m_expandingRing && m_ttlStart <= m_ttlThreshold)
+    {
+      discovery.ttl = m_ttlStart;
+      discovery.timer = Simulator::Schedule (GetRingTraversalTime (discovery.ttl),
+                                             &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+    }
+  else
+    {
+      discovery.ttl = std::numeric_limits<uint8_t>::max ();
+      discovery.timer = Simulator::Schedule (m_rreqTimeout, &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+    }
+  m_stats.discoveriesStarted++;
+  SendRouteRequest (dst, discovery.ttl);
+}
+
+void
+DlarpRoutingProtocol::StartLocalRepair (Ipv4Address dst)
+{
+  if (m_discoveries.find (dst) != m_discoveries.end ())
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this << dst);
+  
+  DiscoveryEntry &discovery = m_discoveries[dst];
+  discovery.retries = 0;
+  discovery.start = Simulator::Now ();
+  discovery.ttl = m_localRepairTtl;
+  discovery.timer = Simulator::Schedule (m_localRepairTimeout, &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+  discovery.localRepair = true;
+  m_stats.repairsStarted++;
+  SendRouteRequest (dst, m_localRepairTtl);
+}
+
+void
+DlarpRoutingProtocol::FailLocalRepair (Ipv4Address dst)
+{
+  NS_LOG_LOGIC ("Local repair of the route to " << dst << " failed");
+  m_stats.repairsFailed++;
+  m_brokenRoutes.erase (dst);
+  
+  std::vector<DlarpRequestQueue::Entry> entries;
+  std::vector<DlarpRequestQueue::Entry> dropped;
+  m_queue.Dequeue (dst, entries, dropped);
+  DropPackets (dropped);
+  dropped.clear ();
+  
+  // One RERR per source whose packets waited; packets of this node get a
+  // full discovery instead
+  std::set<Ipv4Address> sources;
+  std::vector<DlarpRequestQueue::Entry> failed;
+  for (std::vector<DlarpRequestQueue::Entry>::const_iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      Ipv4Address src = i->header.GetSource ();
+      if (IsMyOwnAddress (src))
+        {
+          m_queue.Enqueue (*i, dropped);
+          continue;
+        }
+      failed.push_back (*i);
+      if (sources.insert (src).second)
+        {
+          DlarpHeader rerrHeader (DLARPTYPE_RERR);
+          rerrHeader.SetSrc (src);
+          rerrHeader.SetDst (dst);
+          SendToOrigin (rerrHeader);
+        }
+    }
+  DropPackets (failed, DlarpStats::DROP_REPAIR_FAILED);
+  DropPackets (dropped);
+  if (m_queue.Find (dst))
+    {
+      StartRouteDiscovery (dst);
+    }
+}
+
+void
+DlarpRoutingProtocol::RouteDiscoveryTimeout (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  
+  std::map<Ipv4Address, DiscoveryEntry>::iterator it = m_discoveries.find (dst);
+  NS_ASSERT (it != m_discoveries.end ());
+  
+  if (m_routingTable.LookupRoute (dst) != 0)
+    {
+      CompleteRouteDiscovery (dst);
+      return;
+    }
+  
+  if (it->second.localRepair)
+    {
+      m_discoveries.erase (it);
+      FailLocalRepair (dst);
+      return;
+    }
+  
+  // Next ring, or the network-wide flood after the last one
+  if (it->second.ttl < std::numeric_limits<uint8_t>::max ())
+    {
+      uint32_t ttl = it->second.ttl + m_ttlIncrement;
+      if (ttl <= m_ttlThreshold)
+        {
+          it->second.ttl = ttl;
+          it->second.timer = Simulator::Schedule (GetRingTraversalTime (ttl),
+                                                  &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+        }
+      else
+        {
+          it->second.ttl = std::numeric_limits<uint8_t>::max ();
+          it->second.timer = Simulator::Schedule (m_rreqTimeout, &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+        }
+      NS_LOG_LOGIC ("No route to " << dst << " in the ring, TTL now " << (uint32_t) it->second.ttl);
+      SendRouteRequest (dst, it->second.ttl);
+      return;
+    }
+  
+  if (it->second.retries >= m_rreqRetries)
+    {
+      NS_LOG_LOGIC ("Route discovery to " << dst << " failed after " << it->second.retries << " retries");
+      m_stats.discoveriesFailed++;
+      m_discoveryTrace (dst, Simulator::Now () - it->second.start, false);
+      m_discoveries.erase (it);
+      m_unreachable[dst] = Simulator::Now () + m_unreachableTimeout;
+      std::vector<DlarpRequestQueue::Entry> entries;
+      std::vector<DlarpRequestQueue::Entry> dropped;
+      m_queue.Dequeue (dst, entries, dropped);
+      DropPackets (entries, DlarpStats::DROP_DISCOVERY_FAILED);
+      DropPackets (dropped);
+      return;
+    }
+  
+  // Binary exponential backoff
+  it->second.retries++;
+  Time timeout = m_rreqTimeout * (int64_t (1) << it->second.retries);
+  it->second.timer = Simulator::Schedule (timeout, &DlarpRoutingProtocol::RouteDiscoveryTimeout, this, dst);
+  SendRouteRequest (dst, std::numeric_limits<uint8_t>::max ());
+}
+
+Time
+DlarpRoutingProtocol::GetRingTraversalTime (uint8_t ttl) const
+{
+  return m_nodeTraversalTime * int64_t (2 * (ttl + 2));
+}
+
+void
+DlarpRoutingProtocol::CompleteRouteDiscovery (Ipv4Address dst)
+{
+  m_unreachable.erase (dst);
+  
+  std::map<Ipv4Address, DiscoveryEntry>::iterator it = m_discoveries.find (dst);
+  if (it == m_discoveries.end ())
+    {
+      return;
+    }
+  Time latency = Simulator::Now () - it->second.start;
+  NS_LOG_LOGIC ("Route to " << dst << " found in " << latency.As (Time::MS));
+  if (it->second.localRepair)
+    {
+      m_stats.repairsSucceeded++;
+      m_brokenRoutes.erase (dst);
+    }
+  else
+    {
+      m_stats.discoveriesSucceeded++;
+      m_stats.discoveryLatency += latency;
+      m_stats.maxDiscoveryLatency = std::max (m_stats.maxDiscoveryLatency, latency);
+      m_discoveryTrace (dst, latency, true);
+    }
+  it->second.timer.Cancel ();
+  m_discoveries.erase (it);
+  SendPacketsFromQueue (dst);
+}
+
+bool
+DlarpRoutingProtocol::IsUnreachable (Ipv4Address dst)
+{
+  std::map<Ipv4Address, Time>::iterator it = m_unreachable.find (dst);
+  if (it == m_unreachable.end ())
+    {
+      return false;
+    }
+  if (it->second <= Simulator::Now ())
+    {
+      m_unreachable.erase (it);
+      return false;
+    }
+  return true;
+}
+
+void
+DlarpRoutingProtocol::SendRouteReply (Ipv4Address src, Ipv4Address dst, uint32_t seqNo)
+{
+  NS_LOG_FUNCTION (this << src << dst << seqNo);
+  
+  DlarpHeader rrepHeader (DLARPTYPE_RREP);
+  rrepHeader.SetSrc (src);
+  rrepHeader.SetDst (dst);
+  rrepHeader.SetSeqNo (seqNo);
+  rrepHeader.SetHopCount (0);
+  rrepHeader.SetMetric (0);
+  SendToOrigin (rrepHeader);
+}
+
+void
+DlarpRoutingProtocol::SendToOrigin (const DlarpHeader &header)
+{
+  // A RREP travels back along the reverse route towards the RREQ
+  // originator, a RERR along the route towards the data source
+  DlarpRoutingTableEntry *toOrigin = m_routingTable.LookupRoute (header.GetSrc ());
+  if (toOrigin == 0)
+    {
+      NS_LOG_DEBUG ("No route to " << header.GetSrc () << ", dropping " << header);
+      return;
+    }
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (toOrigin->GetInterface (), 0));
+  if (socket == 0)
+    {
+      return;
+    }
+  
+  SendTo (socket, header, toOrigin->GetNextHop ());
+}
+
+void
+DlarpRoutingProtocol::RecvRouteReply (const DlarpHeader &rrepHeader, Ipv4Address sender, uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << sender << rrepHeader.GetDst ());
+  
+  Time lifeTime = Simulator::Now () + m_routeTimeout;
+  
+  // The sender is a neighbor: keep a one-hop route to it
+  DlarpRoutingTableEntry toSender (sender, sender, interface, 0);
+  toSender.SetMetric (GetLinkMetric (sender));
+  toSender.SetLifeTime (lifeTime);
+  InstallRoute (toSender);
+  
+  // Forward route towards the replying destination
+  double metric = rrepHeader.GetMetric () + GetLinkMetric (sender);
+  DlarpRoutingTableEntry toDst (rrepHeader.GetDst (), sender, interface, rrepHeader.GetSeqNo ());
+  toDst.SetMetric (metric);
+  toDst.SetLifeTime (lifeTime);
+  if (InstallRoute (toDst))
+    {
+      PerformLocalAgreement (rrepHeader.GetDst ());
+    }
+  
+  if (IsMyOwnAddress (rrepHeader.GetSrc ()))
+    {
+      CompleteRouteDiscovery (rrepHeader.GetDst ());
+      return;
+    }
+  
+  DlarpHeader forward = rrepHeader;
+  forward.SetHopCount (rrepHeader.GetHopCount () + 1);
+  forward.SetMetric (metric);
+  SendToOrigin (forward);
+}
+
+void
+DlarpRoutingProtocol::RecvRouteError (const DlarpHeader &rerrHeader, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << sender << rerrHeader.GetSrc () << rerrHeader.GetDst ());
+  
+  Ipv4Address dst = rerrHeader.GetDst ();
+  m_routingTable.DeleteRoute (dst, sender);
+  m_tableSize = m_routingTable.GetNDestinations ();
+  if (m_routingTable.LookupRoute (dst) != 0)
+    {
+      // Another candidate route splices around the break
+      return;
+    }
+  
+  if (IsMyOwnAddress (rerrHeader.GetSrc ()))
+    {
+      StartRouteDiscovery (dst);
+      return;
+    }
+  SendToOrigin (rerrHeader);
+}
+
+double
+DlarpRoutingProtocol::GetLinkMetric (Ipv4Address neighbor) const
+{
+  std::map<Ipv4Address, NeighborEntry>::const_iterator nb = m_neighborTable.find (neighbor);
+  if (nb == m_neighborTable.end ())
+    {
+      return 1.0;
+    }
+  return nb->second.link.GetEtx ();
+}
+
+bool
+DlarpRoutingProtocol::IsMyOwnAddress (Ipv4Address address) const
+{
+  return m_localAddresses.find (address) != m_localAddresses.end ();
+}
+
+Ptr<Socket>
+DlarpRoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress iface) const
+{
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
+       i != m_socketAddresses.end (); ++i)
+    {
+      if (i->second.GetLocal () == iface.GetLocal ())
+        {
+          return i->first;
+        }
+    }
+  return 0;
+}
+
+void
+DlarpRoutingProtocol::SendTo (Ptr<Socket> socket, const DlarpHeader &header, Ipv4Address destination)
+{
+  if (destination.IsBroadcast ())
+    {
+      m_lastBcastTime = Simulator::Now ();
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  if (m_controlMac)
+    {
+      // Truncated MAC right after the message, keyed by the sending interface
+      std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator iface = m_socketAddresses.find (socket);
+      if (iface == m_socketAddresses.end ())
+        {
+          return;
+        }
+      m_macScratch.resize (packet->GetSize ());
+      packet->CopyData (m_macScratch.data (), m_macScratch.size ());
+      uint64_t mac = DlarpKeyTable::ComputeMac (m_keys.GetKey (iface->second.GetLocal ()),
+                                                m_macScratch.data (), m_macScratch.size ());
+      uint8_t tag[8];
+      for (uint32_t i = 0; i < 8; ++i)
+        {
+          tag[i] = mac >> (56 - 8 * i);
+        }
+      packet->AddAtEnd (Create<Packet> (tag, m_macSize));
+    }
+  m_stats.txPackets[header.GetType ()]++;
+  m_stats.txBytes[header.GetType ()] += packet->GetSize ();
+  m_txTrace (header, destination);
+  
+  if (m_aggregationDelay.IsZero ())
+    {
+      m_stats.txDatagrams++;
+      packet->AddPacketTag (DlarpControlTag ());
+      socket->SendTo (packet, 0, InetSocketAddress (destination, DLARP_PORT));
+      return;
+    }
+  
+  BundleKey key (socket, destination);
+  std::map<BundleKey, OutboundBundle>::iterator it = m_outbound.find (key);
+  if (it != m_outbound.end ())
+    {
+      // Room left in the MTU after the IPv4 and UDP headers
+      std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator iface = m_socketAddresses.find (socket);
+      uint32_t mtu = (iface != m_socketAddresses.end ())
+        ? m_ipv4->GetMtu (m_ipv4->GetInterfaceForAddress (iface->second.GetLocal ())) : 0;
+      if (it->second.packet->GetSize () + packet->GetSize () + DLARP_UDP_IPV4_HEADER_SIZE <= mtu)
+        {
+          it->second.packet->AddAtEnd (packet);
+          return;
+        }
+      it->second.timer.Cancel ();
+      SendBundle (key);
+    }
+  
+  OutboundBundle &bundle = m_outbound[key];
+  bundle.packet = packet;
+  bundle.timer = Simulator::Schedule (m_aggregationDelay, &DlarpRoutingProtocol::SendBundle, this, key);
+}
+
+void
+DlarpRoutingProtocol::SendBundle (BundleKey key)
+{
+  std::map<BundleKey, OutboundBundle>::iterator it = m_outbound.find (key);
+  if (it == m_outbound.end ())
+    {
+      return;
+    }
+  Ptr<Packet> packet = it->second.packet;
+  m_outbound.erase (it);
+  // The interface may have gone down in the meantime
+  if (m_socketAddresses.find (key.first) == m_socketAddresses.end ())
+    {
+      return;
+    }
+  NS_LOG_LOGIC ("Sending " << packet->GetSize () << " bytes of DLARP messages to " << key.second);
+  m_stats.txDatagrams++;
+  packet->AddPacketTag (DlarpControlTag ());
+  key.first->SendTo (packet, 0, InetSocketAddress (key.second, DLARP_PORT));
+}
+
+bool
+DlarpRoutingProtocol::HasSession (const DlarpRoutingTableEntry *entry, Ipv4Address dst)
+{
+  if (!m_authentication)
+    {
+      return true;
+    }
+  Ipv4Address nextHop = entry->GetNextHop ();
+  DlarpSessionCache::Session *session = m_sessions.Lookup (nextHop);
+  if (session != 0)
+    {
+      if (session->suspended)
+        {
+          NS_LOG_LOGIC ("Resuming session " << session->id << " with " << nextHop);
+          session->suspended = false;
+          m_stats.sessionsResumed++;
+        }
+      return true;
+    }
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (nextHop);
+  if (it == m_handshakes.end ())
+    {
+      StartHandshake (nextHop, entry->GetInterface ());
+      it = m_handshakes.find (nextHop);
+    }
+  it->second.waiting.insert (dst);
+  return false;
+}
+
+void
+DlarpRoutingProtocol::StartHandshake (Ipv4Address peer, uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << peer);
+  
+  Handshake &handshake = m_handshakes[peer];
+  handshake.initiator = true;
+  handshake.id = ++m_handshakeId;
+  handshake.interface = interface;
+  handshake.retries = 0;
+  handshake.start = Simulator::Now ();
+  handshake.processing = Simulator::Schedule (m_authM1Delay, &DlarpRoutingProtocol::SendAuth, this,
+                                              peer, DLARPTYPE_AUTH1);
+  handshake.timer = Simulator::Schedule (m_authM1Delay + m_authTimeout,
+                                         &DlarpRoutingProtocol::HandshakeTimeout, this, peer);
+  m_stats.handshakesStarted++;
+}
+
+void
+DlarpRoutingProtocol::SendAuth (Ipv4Address peer, DlarpPacketType type)
+{
+  std::map<Ipv4Address, Handshake>::const_iterator it = m_handshakes.find (peer);
+  if (it == m_handshakes.end ())
+    {
+      return;
+    }
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (it->second.interface, 0));
+  if (socket == 0)
+    {
+      return;
+    }
+  DlarpHeader header (type);
+  header.SetSeqNo (it->second.id);
+  SendTo (socket, header, peer);
+}
+
+void
+DlarpRoutingProtocol::RecvAuth1 (const DlarpHeader &header, Ipv4Address sender, uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << sender << header.GetSeqNo ());
+  
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (sender);
+  if (it == m_handshakes.end ())
+    {
+      it = m_handshakes.insert (std::make_pair (sender, Handshake ())).first;
+      it->second.start = Simulator::Now ();
+      m_stats.handshakesStarted++;
+    }
+  else if (it->second.initiator)
+    {
+      // Both sides started a handshake: the lower address wins
+      if (m_ipv4->GetAddress (interface, 0).GetLocal () < sender)
+        {
+          NS_LOG_LOGIC ("Ignoring M1 of " << sender << ", which will answer ours");
+          return;
+        }
+      NS_LOG_LOGIC ("Abandoning our handshake with " << sender << " for its own");
+    }
+  // A repeated M1 means that our M2 was lost: compute and send it again
+  Handshake &handshake = it->second;
+  handshake.initiator = false;
+  handshake.id = header.GetSeqNo ();
+  handshake.interface = interface;
+  handshake.retries = 0;
+  handshake.processing.Cancel ();
+  handshake.processing = Simulator::Schedule (m_authM2Delay, &DlarpRoutingProtocol::SendAuth, this,
+                                              sender, DLARPTYPE_AUTH2);
+  handshake.timer.Cancel ();
+  handshake.timer = Simulator::Schedule (m_authM2Delay + m_authTimeout,
+                                         &DlarpRoutingProtocol::HandshakeTimeout, this, sender);
+}
+
+void
+DlarpRoutingProtocol::RecvAuth2 (const DlarpHeader &header, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << sender << header.GetSeqNo ());
+  
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (sender);
+  // Stale, or a duplicate arriving while M3 is being computed
+  if (it == m_handshakes.end () || !it->second.initiator || it->second.id != header.GetSeqNo ()
+      || it->second.processing.IsRunning ())
+    {
+      return;
+    }
+  it->second.timer.Cancel ();
+  it->second.processing = Simulator::Schedule (m_authM3Delay, &DlarpRoutingProtocol::SendAuth3, this, sender);
+}
+
+void
+DlarpRoutingProtocol::RecvAuth3 (const DlarpHeader &header, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << sender << header.GetSeqNo ());
+  
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (sender);
+  if (it == m_handshakes.end () || it->second.initiator || it->second.id != header.GetSeqNo ()
+      || it->second.processing.IsRunning ())
+    {
+      return;
+    }
+  it->second.timer.Cancel ();
+  it->second.processing = Simulator::Schedule (m_authM3CheckDelay, &DlarpRoutingProtocol::EstablishSession,
+                                               this, sender);
+}
+
+void
+DlarpRoutingProtocol::SendAuth3 (Ipv4Address peer)
+{
+  SendAuth (peer, DLARPTYPE_AUTH3);
+  EstablishSession (peer);
+}
+
+void
+DlarpRoutingProtocol::EstablishSession (Ipv4Address peer)
+{
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (peer);
+  NS_ASSERT (it != m_handshakes.end ());
+  Time latency = Simulator::Now () - it->second.start;
+  NS_LOG_LOGIC ("Session " << it->second.id << " with " << peer << " established in " << latency.As (Time::MS));
+  m_sessions.Insert (peer, it->second.id);
+  m_stats.handshakesSucceeded++;
+  m_stats.handshakeLatency += latency;
+  m_stats.maxHandshakeLatency = std::max (m_stats.maxHandshakeLatency, latency);
+  m_handshakeTrace (peer, latency, true);
+  std::set<Ipv4Address> waiting;
+  waiting.swap (it->second.waiting);
+  m_handshakes.erase (it);
+  for (std::set<Ipv4Address>::const_iterator i = waiting.begin (); i != waiting.end (); ++i)
+    {
+      SendPacketsFromQueue (*i);
+    }
+}
+
+void
+DlarpRoutingProtocol::HandshakeTimeout (Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this << peer);
+  
+  std::map<Ipv4Address, Handshake>::iterator it = m_handshakes.find (peer);
+  NS_ASSERT (it != m_handshakes.end ());
+  if (it->second.initiator && it->second.retries < m_authRetries)
+    {
+      it->second.retries++;
+      SendAuth (peer, DLARPTYPE_AUTH1);
+      it->second.timer = Simulator::Schedule (m_authTimeout, &DlarpRoutingProtocol::HandshakeTimeout, this, peer);
+      return;
+    }
+  if (!it->second.initiator)
+    {
+      // The initiator established the session when it sent M3: if M3 was
+      // lost, the neighbor trusts us, so only forget the half-open
+      // handshake, and start ours for the packets that waited on it
+      NS_LOG_LOGIC ("Handshake started by " << peer << " not completed");
+      it->second.processing.Cancel ();
+      std::set<Ipv4Address> waiting;
+      waiting.swap (it->second.waiting);
+      uint32_t interface = it->second.interface;
+      m_handshakes.erase (it);
+      if (!waiting.empty ())
+        {
+          StartHandshake (peer, interface);
+          m_handshakes[peer].waiting.swap (waiting);
+        }
+      return;
+    }
+  
+  NS_LOG_LOGIC ("Handshake with " << peer << " failed");
+  m_stats.handshakesFailed++;
+  m_handshakeTrace (peer, Simulator::Now () - it->second.start, false);
+  it->second.processing.Cancel ();
+  std::set<Ipv4Address> waiting;
+  waiting.swap (it->second.waiting);
+  m_handshakes.erase (it);
+  
+  // The neighbor cannot be trusted: find other routes for the next packets
+  std::set<Ipv4Address> untrusted;
+  untrusted.insert (peer);
+  std::vector<std::pair<Ipv4Address, Time> > unreachable;
+  m_routingTable.DeleteRoutesVia (untrusted, unreachable);
+  m_tableSize = m_routingTable.GetNDestinations ();
+  for (std::set<Ipv4Address>::const_iterator i = waiting.begin (); i != waiting.end (); ++i)
+    {
+      std::vector<DlarpRequestQueue::Entry> entries;
+      std::vector<DlarpRequestQueue::Entry> dropped;
+      m_queue.Dequeue (*i, entries, dropped);
+      DropPackets (entries, DlarpStats::DROP_AUTH_FAILED);
+      DropPackets (dropped);
+    }
+}
+
+void
+DlarpRoutingProtocol::PerformLocalAgreement (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  
+  m_agreementPending.insert (dst);
+  if (!m_agreementEvent.IsRunning ())
+    {
+      m_agreementEvent = Simulator::Schedule (m_agreementWindow, &DlarpRoutingProtocol::SendAgreement, this);
+    }
+}
+
+void
+DlarpRoutingProtocol::SendAgreement ()
+{
+  NS_LOG_FUNCTION (this << m_agreementPending.size ());
+  
+  // Routes that expired or vanished during the window are not advertised
+  std::vector<DlarpAgreementRecord> records;
+  records.reserve (m_agreementPending.size ());
+  for (std::set<Ipv4Address>::const_iterator i = m_agreementPending.begin (); i != m_agreementPending.end (); ++i)
+    {
+      DlarpRoutingTableEntry *entry = m_routingTable.LookupRoute (*i);
+      if (entry != 0)
+        {
+          DlarpAgreementRecord record;
+          record.dst = *i;
+          record.nextHop = entry->GetNextHop ();
+          record.seqNo = entry->GetSeqNo ();
+          record.metric = entry->GetMetric ();
+          records.push_back (record);
+        }
+    }
+  m_agreementPending.clear ();
+  
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin ();
+       i != m_socketAddresses.end (); ++i)
+    {
+      // As many records per message as fit in the interface MTU, with the
+      // IPv4 and UDP headers and the MAC of the message
+      uint32_t mtu = m_ipv4->GetMtu (m_ipv4->GetInterfaceForAddress (i->second.GetLocal ()));
+      uint32_t overhead = DLARP_UDP_IPV4_HEADER_SIZE + DLARP_AGREEMENT_HEADER_SIZE + (m_controlMac ? m_macSize : 0);
+      uint32_t perMessage = (mtu > overhead + DLARP_AGREEMENT_RECORD_SIZE)
+        ? (mtu - overhead) / DLARP_AGREEMENT_RECORD_SIZE : 1;
+      perMessage = std::min (perMessage, DLARP_MAX_AGREEMENT_RECORDS);
+      
+      for (uint32_t first = 0; first < records.size (); first += perMessage)
+        {
+          DlarpHeader header (DLARPTYPE_AGREEMENT);
+          for (uint32_t j = first; j < records.size () && j < first + perMessage; ++j)
+            {
+              header.AddAgreementRecord (records[j]);
+            }
+          SendTo (i->first, header, Ipv4Address::GetBroadcast ());
+        }
+    }
+}
+
+void
+DlarpRoutingProtocol::UpdateRouteByLocalAgreement (const DlarpHeader &agreement, Ipv4Address sender, uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << sender << agreement.GetNAgreementRecords ());
+  
+  Time lifeTime = Simulator::Now () + m_routeTimeout;
+  double linkMetric = GetLinkMetric (sender);
+  for (uint32_t i = 0; i < agreement.GetNAgreementRecords (); ++i)
+    {
+      const DlarpAgreementRecord &record = agreement.GetAgreementRecord (i);
+      if (IsMyOwnAddress (record.dst))
+        {
+          continue;
+        }
+      // Poisoned reverse: the sender routes to dst through us, so a route
+      // through the sender would loop back here
+      if (IsMyOwnAddress (record.nextHop))
+        {
+          m_routingTable.DeleteRoute (record.dst, sender);
+          m_tableSize = m_routingTable.GetNDestinations ();
+          continue;
+        }
+      // A route with an older sequence number than ours is stale, and one as
+      // fresh but no better only counts as a refresh of a route through the sender
+      double metric = record.metric + linkMetric;
+      DlarpRoutingTableEntry *best = m_routingTable.LookupRoute (record.dst);
+      if (best != 0)
+        {
+          int32_t age = int32_t (record.seqNo - best->GetSeqNo ());
+          if (age < 0 || (age == 0 && metric >= best->GetMetric () && !HasRouteVia (record.dst, sender)))
+            {
+              continue;
+            }
+        }
+      DlarpRoutingTableEntry entry (record.dst, sender, interface, record.seqNo);
+      entry.SetMetric (metric);
+      entry.SetLifeTime (lifeTime);
+      InstallRoute (entry);
+    }
+}
+
+bool
+DlarpRoutingProtocol::HasRouteVia (Ipv4Address dst, Ipv4Address nextHop) const
+{
+  const std::vector<DlarpRoutingTableEntry> *candidates = m_routingTable.GetCandidates (dst);
+  if (candidates == 0)
+    {
+      return false;
+    }
+  for (std::vector<DlarpRoutingTableEntry>::const_iterator i = candidates->begin (); i != candidates->end (); ++i)
+    {
+      if (i->GetNextHop () == nextHop)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+int64_t
+DlarpRoutingProtocol::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uniformRandomVariable->SetStream (stream);
+  return 1;
+}
+
+void
+DlarpRoutingProtocol::AppendSnapshot (std::vector<DlarpSnapshotRecord> &records) const
+{
+  uint32_t node = m_ipv4->GetObject<Node> ()->GetId ();
+  m_routingTable.AppendSnapshot (node, records);
+  
+  Time now = Simulator::Now ();
+  for (std::map<Ipv4Address, NeighborEntry>::const_iterator i = m_neighborTable.begin ();
+       i != m_neighborTable.end (); ++i)
+    {
+      DlarpSnapshotRecord record;
+      record.time = now.GetNanoSeconds ();
+      record.node = node;
+      record.address = i->first.Get ();
+      record.nextHop = 0;
+      record.seqNo = 0;
+      record.metric = i->second.link.GetEtx ();
+      record.lifetime = DlarpSnapshotRecord::EncodeLifetime (i->second.expire - now);
+      record.interface = 0;
+      record.kind = DlarpSnapshotRecord::NEIGHBOR;
+      record.flags = 0;
+      record.reserved = 0;
+      records.push_back (record);
+    }
+}
+
+DlarpStats
+DlarpRoutingProtocol::GetStats () const
+{
+  DlarpStats stats = m_stats;
+  DlarpRoutingTable::MemoryUsage memory = m_routingTable.GetMemoryUsage ();
+  stats.tableSize = memory.destinations;
+  stats.tableCandidates = memory.candidates;
+  stats.tableBytes = memory.bytes;
+  return stats;
+}
+
+void
+DlarpRoutingProtocol::ResetStats ()
+{
+  m_stats.Clear ();
+}
+
+DlarpRoutingTable &
+DlarpRoutingProtocol::GetRoutingTable ()
+{
+  return m_routingTable;
+}
+
+void
+DlarpRoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+  *stream->GetStream () << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+                        << ", DLARP Routing table:" << std::endl;
+                        
+  m_routingTable.Print (stream, unit);
 }
 
 } // namespace ns3
\ No newline at end of file
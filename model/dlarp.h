@@ -11,9 +11,24 @@
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/timer.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-mac-queue-item.h"
+#include "dlarp-rtable.h"
+#include "dlarp-packet.h"
+#include "dlarp-id-cache.h"
+#include "dlarp-timer-wheel.h"
+#include "dlarp-link-estimator.h"
+#include "dlarp-rqueue.h"
+#include "dlarp-stats.h"
+#include "dlarp-session-cache.h"
+#include "dlarp-key-table.h"
 #include <map>
 #include <vector>
 #include <set>
+#include <unordered_set>
 
 namespace ns3 {
 
@@ -22,7 +37,6 @@ class NetDevice;
 class Ipv4Interface;
 class Ipv4Address;
 class Ipv4Header;
-class DlarpRoutingTableEntry;
 class Ipv4Route;
 class Socket;
 class Ipv4EndPoint;
@@ -43,6 +57,9 @@ public:
   DlarpRoutingProtocol ();
   virtual ~DlarpRoutingProtocol ();
 
+  /// UDP port of the DLARP control traffic
+  static const uint16_t DLARP_PORT;
+
   // Inherited methods from Ipv4RoutingProtocol
   Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
   bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
@@ -54,6 +71,88 @@ public:
   virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address);
   virtual void SetIpv4 (Ptr<Ipv4> ipv4);
   virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
+  
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+  
+  /**
+   * \return the routing table, for benchmarks that fill it with synthetic
+   *         routes instead of running route discoveries
+   */
+  DlarpRoutingTable & GetRoutingTable ();
+  
+  /**
+   * \brief Hash the flow of a packet
+   *
+   * A flow is identified by its addresses and protocol only: RouteOutput
+   * sees packets before their transport header is added, so ports would
+   * hash the payload at the source and the header at the other hops, and
+   * a flow would change path between its source and its queued packets.
+   * Every hop picks the next hop of a flow from this hash.
+   *
+   * \param header the IPv4 header of the packet
+   * \return the flow hash
+   */
+  static uint32_t GetFlowHash (const Ipv4Header &header);
+  
+  /**
+   * \brief Append a snapshot of the routing and neighbor tables
+   * \param records receives one record per candidate route and per neighbor
+   */
+  void AppendSnapshot (std::vector<DlarpSnapshotRecord> &records) const;
+  
+  /// \return the counters of this instance
+  DlarpStats GetStats () const;
+  /// \brief Reset the counters of this instance
+  void ResetStats ();
+  
+  /**
+   * TracedCallback signature of a DLARP message sent or received.
+   *
+   * \param [in] header the message
+   * \param [in] peer the neighbor it is sent to or received from, or the
+   *             broadcast address
+   */
+  typedef void (* ControlTracedCallback)(const DlarpHeader &header, Ipv4Address peer);
+  /**
+   * TracedCallback signature of the end of a route discovery.
+   *
+   * \param [in] dst the destination
+   * \param [in] latency time since the discovery started
+   * \param [in] found whether a route was found
+   */
+  typedef void (* DiscoveryTracedCallback)(Ipv4Address dst, Time latency, bool found);
+  /**
+   * TracedCallback signature of the route lookup of a data packet.
+   *
+   * \param [in] dst the destination
+   * \param [in] hit whether a valid route was found
+   */
+  typedef void (* LookupTracedCallback)(Ipv4Address dst, bool hit);
+  /**
+   * TracedCallback signature of a data packet dropped by DLARP.
+   *
+   * \param [in] packet the packet
+   * \param [in] header its IPv4 header
+   * \param [in] reason why it was dropped
+   */
+  typedef void (* DropTracedCallback)(Ptr<const Packet> packet, const Ipv4Header &header,
+                                      DlarpStats::DropReason reason);
+  /**
+   * TracedCallback signature of the end of an authentication handshake.
+   *
+   * \param [in] peer the neighbor
+   * \param [in] latency time since the handshake started
+   * \param [in] established whether a session was established
+   */
+  typedef void (* HandshakeTracedCallback)(Ipv4Address peer, Time latency, bool established);
 
 private:
   // DLARP-specific methods and members
@@ -62,40 +161,520 @@ private:
    */
   void Start ();
   
+  /**
+   * \brief Rebuild the set of addresses delivered locally: every address
+   * of every up interface, their subnet-directed broadcasts and the
+   * limited broadcast address
+   */
+  void UpdateLocalAddresses ();
+  
   /**
    * \brief Processes a received DLARP packet
    */
   void RecvDlarp (Ptr<Socket> socket);
   
+  /**
+   * \brief Processes one received DLARP message, whose MAC if any was
+   * verified, and counts and traces it as received
+   * \param header the message
+   * \param sender the neighbor it came from
+   * \param interface the receiving interface
+   */
+  void ProcessMessage (const DlarpHeader &header, Ipv4Address sender, uint32_t interface);
+  
+  /// A received message waiting for the verification of its MAC
+  struct PendingMessage
+  {
+    DlarpHeader header;                    //!< The message
+    Ipv4Address sender;                    //!< Neighbor it came from
+    uint32_t interface;                    //!< Receiving interface
+    bool authentic;                        //!< Whether its MAC matched
+    Time arrival;                          //!< When it was received
+  };
+  
+  /**
+   * \brief Verify a message at once, or at the next batch tick
+   * \param message the message
+   */
+  void QueueVerification (const PendingMessage &message);
+  
+  /**
+   * \brief Batch tick: verify every message queued since the last one
+   */
+  void MacBatchTick ();
+  
+  /**
+   * \brief Charge the CPU with the verification of a batch
+   *
+   * Batches are verified one after the other, each costing MacBatchCost
+   * plus MacMessageCost per message.
+   *
+   * \param batch the messages
+   */
+  void StartVerification (const std::vector<PendingMessage> &batch);
+  
+  /**
+   * \brief Process the authentic messages of a verified batch, and drop the others
+   * \param batch the messages
+   */
+  void FinishVerification (std::vector<PendingMessage> batch);
+  
   /**
    * \brief Sends a DLARP route discovery packet
+   * \param dst the destination
+   * \param ttl the number of hops the RREQ may travel
    */
-  void SendRouteRequest (Ipv4Address dst);
+  void SendRouteRequest (Ipv4Address dst, uint8_t ttl);
   
   /**
    * \brief Sends a DLARP route reply packet
+   * \param src the RREQ originator the reply travels back to
+   * \param dst the destination the reply advertises a route to
+   * \param seqNo the sequence number of dst
    */
   void SendRouteReply (Ipv4Address src, Ipv4Address dst, uint32_t seqNo);
   
+  /**
+   * \brief Sends a RREP or a RERR one hop further along the route to its src
+   * \param header the RREP or RERR
+   */
+  void SendToOrigin (const DlarpHeader &header);
+  
+  /**
+   * \brief Processes a received RERR: drop the route to its dst through
+   * the sender and, if no other route is left, pass the error on towards
+   * its src or, at the source, rediscover dst
+   * \param rerrHeader the RERR
+   * \param sender the neighbor the RERR came from
+   */
+  void RecvRouteError (const DlarpHeader &rerrHeader, Ipv4Address sender);
+  
+  /**
+   * \brief Starts a local repair towards dst, a TTL-limited route
+   * discovery on behalf of the sources of the forwarded data, unless a
+   * discovery is already running
+   * \param dst the destination whose route broke at this node
+   */
+  void StartLocalRepair (Ipv4Address dst);
+  
+  /**
+   * \brief Give up a local repair: send a RERR to each source whose
+   * packets waited for it, and drop the packets
+   * \param dst the destination
+   */
+  void FailLocalRepair (Ipv4Address dst);
+  
+  /**
+   * \brief Processes a received RREP
+   * \param rrepHeader the RREP
+   * \param sender the neighbor the RREP came from
+   * \param interface the receiving interface
+   */
+  void RecvRouteReply (const DlarpHeader &rrepHeader, Ipv4Address sender, uint32_t interface);
+  
+  /**
+   * \brief Processes a received RREQ
+   *
+   * A new request installs the reverse route and is either answered, if
+   * it targets this node, or rebroadcast after a random jitter.  Every
+   * duplicate counts one more neighbor relaying the request, and the
+   * pending rebroadcast is cancelled once RreqSuppressionThreshold copies
+   * have been received.
+   *
+   * \param rreqHeader the RREQ
+   * \param sender the neighbor the RREQ came from
+   * \param interface the receiving interface
+   */
+  void RecvRouteRequest (const DlarpHeader &rreqHeader, Ipv4Address sender, uint32_t interface);
+  
+  /**
+   * \brief Broadcasts a RREQ on behalf of its originator
+   * \param rreqHeader the RREQ, hop count and metric already updated
+   */
+  void RebroadcastRouteRequest (DlarpHeader rreqHeader);
+  
+  /**
+   * \brief Set the size of the duplicate RREQ cache
+   * \param size number of requests remembered
+   */
+  void SetRreqIdCacheSize (uint32_t size);
+  /// \return the size of the duplicate RREQ cache
+  uint32_t GetRreqIdCacheSize () const;
+  /**
+   * \brief Set how long a RREQ is remembered as seen
+   *
+   * Meant to be set before the simulation starts: see
+   * DlarpIdCache::SetLifetime for the effect of shortening it later.
+   *
+   * \param lifetime the lifetime
+   */
+  void SetRreqIdCacheLifetime (Time lifetime);
+  /// \return how long a RREQ is remembered as seen
+  Time GetRreqIdCacheLifetime () const;
+  
+  /// \param lifetime lifetime of an authenticated session
+  void SetSessionLifetime (Time lifetime);
+  /// \return the lifetime of an authenticated session
+  Time GetSessionLifetime () const;
+  
+  /// \param n maximum number of candidate routes per destination, 0 for no limit
+  void SetMaxCandidates (uint32_t n);
+  /// \return the maximum number of candidate routes per destination
+  uint32_t GetMaxCandidates () const;
+  /// \param len maximum number of packets of the send buffer; drops its packets
+  void SetMaxQueueLen (uint32_t len);
+  /// \return the maximum number of packets of the send buffer
+  uint32_t GetMaxQueueLen () const;
+  /// \param bytes maximum number of bytes of the send buffer
+  void SetMaxQueueBytes (uint32_t bytes);
+  /// \return the maximum number of bytes of the send buffer
+  uint32_t GetMaxQueueBytes () const;
+  /// \param t how long a packet may wait in the send buffer
+  void SetMaxQueueTime (Time t);
+  /// \return how long a packet may wait in the send buffer
+  Time GetMaxQueueTime () const;
+  /// \param policy what the send buffer drops when full
+  void SetQueueDropPolicy (DlarpRequestQueue::DropPolicy policy);
+  /// \return what the send buffer drops when full
+  DlarpRequestQueue::DropPolicy GetQueueDropPolicy () const;
+  
+  /**
+   * \brief Route to the loopback device, for packets that wait for a route
+   *
+   * The packet comes back through RouteInput on the loopback device, with
+   * the forwarding and error callbacks needed to send or drop it later.
+   *
+   * \param header the IPv4 header of the packet
+   * \param oif the output device requested, if any
+   * \return the route
+   */
+  Ptr<Ipv4Route> LoopbackRoute (const Ipv4Header &header, Ptr<NetDevice> oif) const;
+  
+  /**
+   * \brief Forward a packet if a route exists, or hold it in the send buffer
+   * \param p the packet
+   * \param header its IPv4 header
+   * \param ucb the forwarding callback
+   * \param ecb the error callback
+   */
+  void DeferRouteOutput (Ptr<const Packet> p, const Ipv4Header &header,
+                         UnicastForwardCallback ucb, ErrorCallback ecb);
+  
+  /**
+   * \brief Forward, in one batch, every packet buffered for dst
+   * \param dst the destination, to which a route was just found
+   */
+  void SendPacketsFromQueue (Ipv4Address dst);
+  
+  /**
+   * \brief Report buffered packets as undeliverable
+   * \param dropped the packets
+   * \param reason why they are dropped, unless they expired
+   */
+  void DropPackets (const std::vector<DlarpRequestQueue::Entry> &dropped,
+                    DlarpStats::DropReason reason = DlarpStats::DROP_QUEUE_FULL);
+  
+  /**
+   * \brief Count and trace a dropped data packet
+   * \param p the packet
+   * \param header its IPv4 header
+   * \param reason why it is dropped
+   */
+  void NotifyDrop (Ptr<const Packet> p, const Ipv4Header &header, DlarpStats::DropReason reason);
+  
+  /**
+   * \brief Starts a route discovery towards dst, unless one is already running
+   * \param dst the destination
+   */
+  void StartRouteDiscovery (Ipv4Address dst);
+  
+  /**
+   * \brief Sends the next ring of an expanding-ring search; after the
+   * last ring, retries a route discovery with exponential backoff, or
+   * gives up and puts the destination in the negative cache; a local
+   * repair is not retried
+   * \param dst the destination
+   */
+  void RouteDiscoveryTimeout (Ipv4Address dst);
+  
+  /**
+   * \param ttl the TTL of a RREQ
+   * \return how long to wait for the RREP: the round trip through ttl
+   *         hops plus a margin of two hops, NodeTraversalTime each
+   */
+  Time GetRingTraversalTime (uint8_t ttl) const;
+  
+  /**
+   * \brief Ends the route discovery towards dst after a route was found
+   * \param dst the destination
+   */
+  void CompleteRouteDiscovery (Ipv4Address dst);
+  
+  /**
+   * \param dst the destination
+   * \return true if a recent discovery towards dst failed
+   */
+  bool IsUnreachable (Ipv4Address dst);
+  
+  /**
+   * \param neighbor the neighbor
+   * \return the ETX of the link towards neighbor, 1 if nothing is known
+   *         about it yet
+   */
+  double GetLinkMetric (Ipv4Address neighbor) const;
+  
+  /**
+   * \param address an address
+   * \return true if address is delivered locally
+   */
+  bool IsMyOwnAddress (Ipv4Address address) const;
+  
+  /**
+   * \param iface the interface address
+   * \return the DLARP socket bound to iface, or 0
+   */
+  Ptr<Socket> FindSocketWithInterfaceAddress (Ipv4InterfaceAddress iface) const;
+  
+  /**
+   * \brief Sends a DLARP message
+   *
+   * With a non-zero AggregationDelay, the message waits in the outbound
+   * bundle of its socket and destination, which is sent when the delay
+   * expires or when the next message would not fit in the MTU.
+   *
+   * \param socket the DLARP socket of the outgoing interface
+   * \param header the message
+   * \param destination the neighbor, or the broadcast address
+   */
+  void SendTo (Ptr<Socket> socket, const DlarpHeader &header, Ipv4Address destination);
+  
+  /// Socket and destination of an outbound bundle
+  typedef std::pair<Ptr<Socket>, Ipv4Address> BundleKey;
+  
+  /**
+   * \brief Send the messages bundled for a socket and destination
+   * \param key the socket and destination
+   */
+  void SendBundle (BundleKey key);
+  
+  /**
+   * \brief Get the Ipv4Route for a routing table entry, building and
+   * caching it on first use
+   * \param entry the routing table entry
+   * \return the route
+   */
+  Ptr<Ipv4Route> GetCachedRoute (DlarpRoutingTableEntry *entry);
+  
+  /**
+   * \brief Look up the route of a packet, by flow when multipath is enabled
+   * \param header the IPv4 header of the packet
+   * \return the route, or 0 if there is no valid route
+   */
+  DlarpRoutingTableEntry * LookupRoute (const Ipv4Header &header);
+
+  
+  /**
+   * \brief Check that data may be routed through the next hop of a route
+   *
+   * With authentication enabled, the next hop needs a live session.  If
+   * it has none, a handshake with it is started, unless one is running
+   * already, and dst is recorded as waiting for its end.
+   *
+   * \param entry the route
+   * \param dst the destination of the data
+   * \return true if the route may be used now
+   */
+  bool HasSession (const DlarpRoutingTableEntry *entry, Ipv4Address dst);
+  
+  /**
+   * \brief Start an authentication handshake as its initiator
+   *
+   * M1 is sent once it has been computed, after AuthM1Delay.
+   *
+   * \param peer the neighbor
+   * \param interface the interface towards it
+   */
+  void StartHandshake (Ipv4Address peer, uint32_t interface);
+  
+  /**
+   * \brief Send a message of the handshake with a neighbor
+   * \param peer the neighbor
+   * \param type AUTH1, AUTH2 or AUTH3
+   */
+  void SendAuth (Ipv4Address peer, DlarpPacketType type);
+  
+  /**
+   * \brief Processes a received M1: answer it with M2 after AuthM2Delay
+   *
+   * When both neighbors start a handshake at the same time, the one
+   * started by the lower address goes on and the other is abandoned.
+   *
+   * \param header the message
+   * \param sender the neighbor
+   * \param interface the receiving interface
+   */
+  void RecvAuth1 (const DlarpHeader &header, Ipv4Address sender, uint32_t interface);
+  
+  /**
+   * \brief Processes a received M2: answer it with M3 after AuthM3Delay
+   * \param header the message
+   * \param sender the neighbor
+   */
+  void RecvAuth2 (const DlarpHeader &header, Ipv4Address sender);
+  
+  /**
+   * \brief Processes a received M3: establish the session after AuthM3CheckDelay
+   * \param header the message
+   * \param sender the neighbor
+   */
+  void RecvAuth3 (const DlarpHeader &header, Ipv4Address sender);
+  
+  /**
+   * \brief Send M3 and establish the session, on the initiator side
+   * \param peer the neighbor
+   */
+  void SendAuth3 (Ipv4Address peer);
+  
+  /**
+   * \brief End a handshake successfully and send the packets that waited for it
+   * \param peer the neighbor
+   */
+  void EstablishSession (Ipv4Address peer);
+  
+  /**
+   * \brief Resend M1, or give up the handshake, drop the packets that
+   * waited for it and the routes through the neighbor
+   *
+   * On the responder side, the handshake is only forgotten: the initiator
+   * established the session when it sent M3, and a lost M3 does not make
+   * it untrusted.  Packets that waited on the handshake start one of ours.
+   *
+   * \param peer the neighbor
+   */
+  void HandshakeTimeout (Ipv4Address peer);
+  
   /**
    * \brief Performs the local agreement phase of DLARP
+   *
+   * Queues dst for the next AGREEMENT message: every destination whose
+   * route changes during the agreement window is advertised to the
+   * neighbors in one message per interface.
+   *
+   * \param dst the destination whose route changed
    */
   void PerformLocalAgreement (Ipv4Address dst);
   
+  /**
+   * \brief Send the routes queued by PerformLocalAgreement
+   */
+  void SendAgreement ();
+  
   /**
    * \brief Checks and updates the routing table based on local agreement
+   *
+   * Applies every record of a received AGREEMENT as a candidate route
+   * through its sender, skipping records older than the known route, and
+   * records as fresh but no better unless they refresh a route through
+   * the sender.  A record whose next hop is this node is poisoned: it
+   * removes the route through the sender instead.  The routes learned
+   * from an AGREEMENT are not advertised again: only the end of a route
+   * discovery starts a local agreement.
+   *
+   * \param agreement the AGREEMENT message
+   * \param sender the neighbor that sent it
+   * \param interface the interface it was received on
    */
-  bool UpdateRouteByLocalAgreement (Ipv4Address dst);
+  void UpdateRouteByLocalAgreement (const DlarpHeader &agreement, Ipv4Address sender, uint32_t interface);
+  /**
+   * \param dst a destination
+   * \param nextHop a neighbor
+   * \return true if a candidate route towards dst goes through nextHop
+   */
+  bool HasRouteVia (Ipv4Address dst, Ipv4Address nextHop) const;
   
   /**
    * \brief Sends periodic hello messages to discover neighbors
    */
   void SendHello ();
   
+  /**
+   * \brief HELLO timer handler: adapts the interval to the neighbor-set
+   * churn in adaptive mode, sends a HELLO unless a recent broadcast made
+   * it redundant, drops the expired buffered packets, and reschedules
+   * itself
+   */
+  void HelloTimerFire ();
+  
+  /**
+   * \brief Refresh a neighbor after hearing a DLARP message from it
+   * \param neighbor the neighbor
+   */
+  void UpdateNeighbor (Ipv4Address neighbor);
+  
+  /**
+   * \brief Update the link estimator of a neighbor with its HELLO
+   * \param helloHeader the HELLO
+   * \param sender the neighbor, already in the neighbor table
+   */
+  void RecvHello (const DlarpHeader &helloHeader, Ipv4Address sender);
+  
   /**
    * \brief Handle hello timeout (neighbor expiry)
+   *
+   * Tick of the expiry timer wheel: expires the neighbors and routes due
+   * at this tick in one batch, re-arms the ones refreshed in between and
+   * purges the routes through every expired neighbor in one pass.
    */
   void HelloTimerExpire ();
+  
+  /**
+   * \brief Drop the sessions, keys and routes of lost neighbors, and
+   * rediscover the active destinations left without a route
+   * \param lostNeighbors the neighbors, already out of the neighbor table
+   */
+  void LoseNeighbors (const std::set<Ipv4Address> &lostNeighbors);
+  
+  /**
+   * \brief Invalidate a neighbor at once, on a link-layer transmit failure
+   * \param neighbor the neighbor
+   */
+  void BreakLink (Ipv4Address neighbor);
+  
+  /**
+   * \brief Hook the transmit-failure traces of the Wi-Fi MAC of an interface
+   * \param interface the interface; other devices are ignored
+   */
+  void ConnectLinkLayerFeedback (uint32_t interface);
+  
+  /**
+   * \brief Wi-Fi MAC gave up sending a frame: break the link with the
+   * neighbors behind the receiver address
+   * \param address the MAC address of the receiver
+   */
+  void NotifyTxFailed (Mac48Address address);
+  
+  /**
+   * \brief Wi-Fi MAC dropped an MPDU; only the retry limit breaks the link
+   * \param reason why it was dropped
+   * \param mpdu the MPDU
+   */
+  void NotifyDroppedMpdu (WifiMacDropReason reason, Ptr<const WifiMacQueueItem> mpdu);
+  
+  /**
+   * \brief Arm an expiry timer, starting the wheel if it is idle
+   * \param kind neighbor or route
+   * \param address the neighbor or destination
+   * \param expire when it expires
+   */
+  void ScheduleExpiry (DlarpTimerWheel::Kind kind, Ipv4Address address, Time expire);
+  
+  /**
+   * \brief Add a route to the routing table, arming the expiry timer of a
+   * new destination
+   * \param entry the route
+   * \return true if the best route towards the destination changed
+   */
+  bool InstallRoute (const DlarpRoutingTableEntry &entry);
 
   // Data structures and variables
   Ptr<Ipv4> m_ipv4;                       //!< IPv4 reference
@@ -103,49 +682,145 @@ private:
   Time m_helloInterval;                    //!< Interval between hello messages
   Time m_routeTimeout;                     //!< Route validity timeout
   Time m_neighborTimeout;                  //!< Neighbor validity timeout
+  bool m_linkLayerFeedback;                //!< Whether Wi-Fi transmit failures break links
   Timer m_helloTimer;                      //!< Timer for sending hello messages
+  bool m_enableMultipath;                  //!< Whether flows are spread over the candidate routes
+  bool m_adaptiveHello;                    //!< Whether the HELLO interval adapts to churn
+  Time m_minHelloInterval;                 //!< Lower bound of the adaptive HELLO interval
+  Time m_maxHelloInterval;                 //!< Upper bound of the adaptive HELLO interval
+  double m_helloChurnThreshold;            //!< Churn ratio above which the interval shrinks
+  Time m_currentHelloInterval;             //!< HELLO interval in use
+  Time m_lastBcastTime;                    //!< Last DLARP broadcast, an implicit HELLO
+  uint32_t m_neighborChurn;                //!< Neighbors added or expired since the last HELLO timer
+  Time m_rreqTimeout;                      //!< Wait for a RREP before the first retry
+  uint32_t m_rreqRetries;                  //!< Maximum number of RREQ retries
+  bool m_expandingRing;                    //!< Whether discoveries search in expanding rings first
+  Time m_nodeTraversalTime;                //!< Estimated time for a message to cross one hop
+  uint32_t m_ttlStart;                     //!< TTL of the first ring
+  uint32_t m_ttlIncrement;                 //!< TTL added by every further ring
+  uint32_t m_ttlThreshold;                 //!< Largest ring TTL before the network-wide flood
+  Time m_unreachableTimeout;               //!< Lifetime of a negative cache entry
+  
+  /// State of a route discovery in progress
+  struct DiscoveryEntry
+  {
+    uint32_t retries;                      //!< Network-wide RREQs sent after the first one
+    uint8_t ttl;                           //!< TTL of the last RREQ, 255 once network-wide
+    Time start;                            //!< When the discovery started
+    EventId timer;                         //!< Retry timer
+    bool localRepair;                      //!< Whether it repairs a route of forwarded data
+  };
+  
+  /// Route discoveries in progress, by destination
+  std::map<Ipv4Address, DiscoveryEntry> m_discoveries;
+  /// Negative cache: destinations whose discovery failed, with the entry expiry
+  std::map<Ipv4Address, Time> m_unreachable;
+  
+  bool m_localRepair;                      //!< Whether broken routes are repaired where they broke
+  uint32_t m_localRepairTtl;               //!< Hops a local repair RREQ may travel
+  Time m_localRepairTimeout;               //!< Wait for a RREP before a local repair fails
+  /// Destinations whose last route went with a lost neighbor, until when they may be repaired
+  std::map<Ipv4Address, Time> m_brokenRoutes;
+  
+  DlarpIdCache m_rreqIdCache;              //!< Recently seen RREQs
+  Time m_rreqRebroadcastJitter;            //!< Maximum delay of a RREQ rebroadcast
+  uint32_t m_rreqSuppressionThreshold;     //!< Copies received that cancel a rebroadcast
+  
+  Time m_agreementWindow;                  //!< Time during which route changes are gathered
+  std::set<Ipv4Address> m_agreementPending; //!< Destinations queued for the next AGREEMENT
+  EventId m_agreementEvent;                //!< Pending AGREEMENT transmission
+  
+  DlarpTimerWheel m_expiryWheel;           //!< Expiry timers of neighbors and routes
+  Time m_expiryGranularity;                //!< Tick of the expiry timer wheel
+  EventId m_expiryEvent;                   //!< Next tick of the expiry timer wheel
+  
+  /// DLARP messages waiting to share one datagram
+  struct OutboundBundle
+  {
+    Ptr<Packet> packet;                    //!< The messages, back to back
+    EventId timer;                         //!< End of the aggregation delay
+  };
+  
+  Time m_aggregationDelay;                 //!< Longest wait of a message for others to bundle with
+  std::map<BundleKey, OutboundBundle> m_outbound; //!< Outbound bundles
+  
+  /// State of an authentication handshake in progress
+  struct Handshake
+  {
+    bool initiator;                        //!< Whether this node sent M1
+    uint32_t id;                           //!< Handshake ID, chosen by the initiator
+    uint32_t interface;                    //!< Interface towards the neighbor
+    uint32_t retries;                      //!< M1 retransmissions
+    Time start;                            //!< When the handshake started
+    EventId processing;                    //!< Cryptographic processing in progress
+    EventId timer;                         //!< Wait for the next message of the neighbor
+    std::set<Ipv4Address> waiting;         //!< Destinations whose packets wait for the session
+  };
+  
+  bool m_authentication;                   //!< Whether next hops must be authenticated
+  bool m_sessionResumption;                //!< Whether sessions outlive the loss of their neighbor
+  Time m_authM1Delay;                      //!< Time to compute M1
+  Time m_authM2Delay;                      //!< Time to check M1 and compute M2
+  Time m_authM3Delay;                      //!< Time to check M2 and compute M3
+  Time m_authM3CheckDelay;                 //!< Time to check M3
+  Time m_authTimeout;                      //!< Wait for the answer of the neighbor
+  uint32_t m_authRetries;                  //!< Maximum number of M1 retransmissions
+  uint32_t m_handshakeId;                  //!< ID of the last handshake started
+  std::map<Ipv4Address, Handshake> m_handshakes; //!< Handshakes in progress, by neighbor
+  DlarpSessionCache m_sessions;            //!< Established sessions
+  
+  bool m_controlMac;                       //!< Whether DLARP messages carry a MAC
+  uint32_t m_macSize;                      //!< Size of the truncated MAC
+  Time m_macBatchInterval;                 //!< Tick of the batched verification, 0 for none
+  Time m_macBatchCost;                     //!< CPU time of a verification batch
+  Time m_macMessageCost;                   //!< CPU time of the verification of one message
+  DlarpKeyTable m_keys;                    //!< MAC keys of this node and its neighbors
+  std::vector<PendingMessage> m_macPending; //!< Messages waiting for the next batch tick
+  EventId m_macBatchEvent;                 //!< Next batch tick
+  Time m_cpuBusyUntil;                     //!< End of the verifications under way
+  std::vector<uint8_t> m_macScratch;       //!< Bytes of the datagram being signed or checked
+  
+  DlarpRequestQueue m_queue;               //!< Packets waiting for a route discovery or a session
+  Ptr<NetDevice> m_lo;                     //!< Loopback device, the route of the waiting packets
   
   // Routing table and neighbor information
-  std::map<Ipv4Address, std::vector<DlarpRoutingTableEntry> > m_routingTable;
-  std::map<Ipv4Address, Time> m_neighborTable;
+  DlarpRoutingTable m_routingTable;
+  
+  /// A neighbor and the quality of the link with it
+  struct NeighborEntry
+  {
+    Time expire;                           //!< Expiration time
+    DlarpLinkEstimator link;               //!< ETX estimator of the link
+  };
+  
+  std::map<Ipv4Address, NeighborEntry> m_neighborTable;
+  std::set<Ptr<NetDevice> > m_feedbackDevices; //!< Devices whose MAC traces are hooked
+  uint32_t m_etxWindow;                    //!< HELLOs of the link estimator window
+  
+  /// Addresses for which RouteInput delivers locally
+  std::unordered_set<Ipv4Address, Ipv4AddressHash> m_localAddresses;
   
   // Sockets for sending and receiving DLARP packets
   std::map<Ptr<Socket>, Ipv4InterfaceAddress> m_socketAddresses;
   
   uint32_t m_seqNo;                        //!< Current sequence number
+  uint32_t m_helloSeqNo;                   //!< Sequence number of the last HELLO
   uint32_t m_requestId;                    //!< Current request ID
-};
-
-// Routing table entry for DLARP
-class DlarpRoutingTableEntry
-{
-public:
-  DlarpRoutingTableEntry ();
-  
-  // Constructors
-  DlarpRoutingTableEntry (Ipv4Address dst, Ipv4Address nextHop, uint32_t interface, uint32_t seqNo);
   
-  // Getters and setters
-  Ipv4Address GetDestination () const;
-  Ipv4Address GetNextHop () const;
-  uint32_t GetInterface () const;
-  uint32_t GetSeqNo () const;
-  Time GetLifeTime () const;
-  double GetMetric () const;
-  
-  void SetLifeTime (Time lifeTime);
-  void SetMetric (double metric);
-  void SetNextHop (Ipv4Address nextHop);
-  void SetInterface (uint32_t interface);
-  void SetSeqNo (uint32_t seqNo);
-  
-private:
-  Ipv4Address m_destination;    //!< Destination address
-  Ipv4Address m_nextHop;        //!< Next hop address
-  uint32_t m_interface;         //!< Output interface
-  uint32_t m_seqNo;             //!< Sequence number
-  Time m_lifeTime;              //!< Expiration time
-  double m_metric;              //!< Route metric
+  DlarpStats m_stats;                      //!< Counters of this instance
+  TracedValue<uint32_t> m_tableSize;       //!< Destinations in the routing table
+  /// A DLARP message was sent
+  TracedCallback<const DlarpHeader &, Ipv4Address> m_txTrace;
+  /// A DLARP message was received and processed
+  TracedCallback<const DlarpHeader &, Ipv4Address> m_rxTrace;
+  /// A route discovery ended
+  TracedCallback<Ipv4Address, Time, bool> m_discoveryTrace;
+  /// A data packet looked up its route
+  TracedCallback<Ipv4Address, bool> m_lookupTrace;
+  /// A data packet was dropped
+  TracedCallback<Ptr<const Packet>, const Ipv4Header &, DlarpStats::DropReason> m_dropTrace;
+  /// An authentication handshake ended
+  TracedCallback<Ipv4Address, Time, bool> m_handshakeTrace;
 };
 
 } // namespace ns3
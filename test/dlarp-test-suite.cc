@@ -0,0 +1,896 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/dlarp-rtable.h"
+#include "ns3/dlarp-timer-wheel.h"
+#include "ns3/dlarp-rqueue.h"
+#include "ns3/dlarp-packet.h"
+#include "ns3/dlarp-helper.h"
+#include "ns3/dlarp.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/boolean.h"
+#include "ns3/node-container.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/error-model.h"
+#include "ns3/udp-header.h"
+#include "ns3/udp-l4-protocol.h"
+#include <set>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup dlarp
+ * \defgroup dlarp-test DLARP module tests
+ */
+
+/**
+ * \ingroup dlarp-test
+ * \brief Routing table: insertion, erasure and growth of the open-addressing table
+ */
+class DlarpRoutingTableTest : public TestCase
+{
+public:
+  DlarpRoutingTableTest () : TestCase ("Routing table insert, erase and grow")
+  {
+  }
+  virtual void DoRun (void);
+};
+
+void
+DlarpRoutingTableTest::DoRun (void)
+{
+  // Enough destinations to grow the table several times
+  const uint32_t count = 1000;
+  DlarpRoutingTable table;
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      DlarpRoutingTableEntry entry (Ipv4Address (0x0a000001 + i), Ipv4Address ("10.1.0.1"), 1, i);
+      entry.SetLifeTime (Seconds (100));
+      entry.SetMetric (1 + i % 7);
+      NS_TEST_ASSERT_MSG_EQ (table.AddRoute (entry), true, "A new destination changes its best route");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetNDestinations (), count, "Every destination is in the table");
+
+  // Every other destination leaves holes the others probed past
+  for (uint32_t i = 0; i < count; i += 2)
+    {
+      NS_TEST_ASSERT_MSG_EQ (table.DeleteRoutes (Ipv4Address (0x0a000001 + i)), true, "Destination erased");
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetNDestinations (), count / 2, "Half the destinations are left");
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      DlarpRoutingTableEntry *entry = table.LookupRoute (Ipv4Address (0x0a000001 + i));
+      if (i % 2 == 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ (entry == 0, true, "Erased destination found");
+          continue;
+        }
+      NS_TEST_ASSERT_MSG_EQ (entry != 0, true, "Destination lost by an erasure");
+      NS_TEST_ASSERT_MSG_EQ (entry->GetSeqNo (), i, "Wrong entry found");
+      NS_TEST_ASSERT_MSG_EQ_TOL (entry->GetMetric (), 1 + i % 7, 1.0 / DLARP_METRIC_SCALE, "Wrong metric");
+    }
+
+  // A second next hop is a candidate of the same destination, not a new one
+  DlarpRoutingTableEntry better (Ipv4Address (0x0a000002), Ipv4Address ("10.1.0.2"), 1, 1);
+  better.SetLifeTime (Seconds (100));
+  better.SetMetric (0.5);
+  NS_TEST_ASSERT_MSG_EQ (table.AddRoute (better), true, "A better candidate becomes the best route");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNDestinations (), count / 2, "No new destination");
+  NS_TEST_ASSERT_MSG_EQ (table.LookupRoute (Ipv4Address (0x0a000002))->GetNextHop (), Ipv4Address ("10.1.0.2"),
+                         "Best route not updated");
+  NS_TEST_ASSERT_MSG_EQ (table.DeleteRoute (Ipv4Address (0x0a000002), Ipv4Address ("10.1.0.2")), true,
+                         "Candidate erased");
+  NS_TEST_ASSERT_MSG_EQ (table.LookupRoute (Ipv4Address (0x0a000002))->GetNextHop (), Ipv4Address ("10.1.0.1"),
+                         "The remaining candidate is the best route");
+
+  // The erased destinations come back into the holes
+  for (uint32_t i = 0; i < count; i += 2)
+    {
+      DlarpRoutingTableEntry entry (Ipv4Address (0x0a000001 + i), Ipv4Address ("10.1.0.1"), 1, i);
+      entry.SetLifeTime (Seconds (100));
+      table.AddRoute (entry);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetNDestinations (), count, "Every destination is back");
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      DlarpRoutingTableEntry *entry = table.LookupRoute (Ipv4Address (0x0a000001 + i));
+      NS_TEST_ASSERT_MSG_EQ (entry != 0 && entry->GetSeqNo () == i, true, "Destination not found again");
+    }
+
+  table.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetNDestinations (), 0, "Table not empty after Clear");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Multipath: every packet of a flow takes the same next hop
+ */
+class DlarpFlowHashTest : public TestCase
+{
+public:
+  DlarpFlowHashTest () : TestCase ("One flow, one next hop")
+  {
+  }
+  virtual void DoRun (void);
+};
+
+void
+DlarpFlowHashTest::DoRun (void)
+{
+  const Ipv4Address dst ("10.0.0.9");
+  DlarpRoutingTable table;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      DlarpRoutingTableEntry entry (dst, Ipv4Address (0x0a010001 + i), 1, 1);
+      entry.SetLifeTime (Seconds (100));
+      entry.SetMetric (1 + i);
+      table.AddRoute (entry);
+    }
+
+  // The packets of a flow differ in everything but their addresses and
+  // protocol, and so do the same packet at the source and at later hops
+  std::set<Ipv4Address> nextHops;
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      Ipv4Header header;
+      header.SetSource (Ipv4Address ("10.0.0.1"));
+      header.SetDestination (dst);
+      header.SetProtocol (17);
+      header.SetIdentification (i);
+      header.SetTtl (64 - i % 8);
+      header.SetPayloadSize (8 + 13 * i);
+      DlarpRoutingTableEntry *entry = table.LookupRoute (dst, DlarpRoutingProtocol::GetFlowHash (header));
+      NS_TEST_ASSERT_MSG_EQ (entry != 0, true, "No route for the flow");
+      nextHops.insert (entry->GetNextHop ());
+    }
+  NS_TEST_EXPECT_MSG_EQ (nextHops.size (), 1, "A flow was spread over several next hops");
+
+  // Different flows still spread over the candidates
+  nextHops.clear ();
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      Ipv4Header header;
+      header.SetSource (Ipv4Address (0x0a000100 + i));
+      header.SetDestination (dst);
+      header.SetProtocol (17);
+      nextHops.insert (table.LookupRoute (dst, DlarpRoutingProtocol::GetFlowHash (header))->GetNextHop ());
+    }
+  NS_TEST_EXPECT_MSG_GT (nextHops.size (), 1, "Flows not spread over the candidates");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Timer wheel: timers of every level fire at their tick, after cascading
+ */
+class DlarpTimerWheelTest : public TestCase
+{
+public:
+  DlarpTimerWheelTest () : TestCase ("Timer wheel cascading")
+  {
+  }
+  virtual void DoRun (void);
+};
+
+void
+DlarpTimerWheelTest::DoRun (void)
+{
+  // Ticks on both sides of the boundaries of levels 1, 2 and 3
+  const uint64_t ticks[] = { 1, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 262145, 300000 };
+  const uint32_t count = sizeof (ticks) / sizeof (ticks[0]);
+
+  DlarpTimerWheel wheel;
+  wheel.SetCurrentTick (1000);
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      wheel.Insert (1000 + ticks[i], DlarpTimerWheel::ROUTE, Ipv4Address (i));
+    }
+  // A tick already reached fires at the next one
+  wheel.Insert (999, DlarpTimerWheel::NEIGHBOR, Ipv4Address (count));
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetSize (), count + 1, "Every timer is pending");
+
+  std::vector<uint64_t> fired (count + 1, 0);
+  std::vector<DlarpTimerWheel::Timer> expired;
+  while (!wheel.IsEmpty ())
+    {
+      expired.clear ();
+      wheel.Advance (expired);
+      for (std::vector<DlarpTimerWheel::Timer>::const_iterator i = expired.begin (); i != expired.end (); ++i)
+        {
+          uint32_t index = i->address.Get ();
+          NS_TEST_ASSERT_MSG_LT (index, count + 1, "Unknown timer");
+          NS_TEST_ASSERT_MSG_EQ (fired[index], 0, "Timer fired twice");
+          fired[index] = wheel.GetCurrentTick ();
+        }
+    }
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (fired[i], 1000 + ticks[i], "Timer fired at the wrong tick");
+    }
+  NS_TEST_ASSERT_MSG_EQ (fired[count], 1001, "Past timer did not fire at the next tick");
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Request queue: drop policies under both caps, expiry order of
+ * re-queued packets, expiry of an idle queue and colliding FIFOs
+ */
+class DlarpRequestQueueTest : public TestCase
+{
+public:
+  DlarpRequestQueueTest () : TestCase ("Request queue drops, expiry and FIFO index")
+  {
+  }
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Make a packet waiting for a route
+   * \param dst its destination
+   * \param size its size
+   * \param expire its expiry, zero for a first queueing
+   * \return the entry
+   */
+  static DlarpRequestQueue::Entry MakeEntry (Ipv4Address dst, uint32_t size, Time expire = Time ());
+  /**
+   * \brief Dequeue the packets of a destination
+   * \param queue the queue
+   * \param dst the destination
+   * \return the UIDs of the packets, in dequeuing order
+   */
+  static std::vector<uint64_t> DequeueUids (DlarpRequestQueue &queue, Ipv4Address dst);
+};
+
+DlarpRequestQueue::Entry
+DlarpRequestQueueTest::MakeEntry (Ipv4Address dst, uint32_t size, Time expire)
+{
+  DlarpRequestQueue::Entry entry;
+  entry.packet = Create<Packet> (size);
+  entry.header.SetDestination (dst);
+  entry.expire = expire;
+  return entry;
+}
+
+std::vector<uint64_t>
+DlarpRequestQueueTest::DequeueUids (DlarpRequestQueue &queue, Ipv4Address dst)
+{
+  std::vector<DlarpRequestQueue::Entry> entries;
+  std::vector<DlarpRequestQueue::Entry> dropped;
+  queue.Dequeue (dst, entries, dropped);
+  std::vector<uint64_t> uids;
+  for (std::vector<DlarpRequestQueue::Entry>::const_iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      uids.push_back (i->packet->GetUid ());
+    }
+  return uids;
+}
+
+void
+DlarpRequestQueueTest::DoRun (void)
+{
+  const Ipv4Address a ("10.0.0.1");
+  const Ipv4Address b ("10.0.0.2");
+  const Ipv4Address c ("10.0.0.3");
+  std::vector<DlarpRequestQueue::Entry> dropped;
+
+  // Packet cap: the arriving packet, or the oldest one, is dropped
+  DlarpRequestQueue queue (3, 10000, Seconds (10), DlarpRequestQueue::DROP_TAIL);
+  DlarpRequestQueue::Entry first = MakeEntry (a, 100);
+  NS_TEST_ASSERT_MSG_EQ (queue.Enqueue (first, dropped), true, "Packet not queued");
+  NS_TEST_ASSERT_MSG_EQ (queue.Enqueue (MakeEntry (b, 100), dropped), true, "Packet not queued");
+  NS_TEST_ASSERT_MSG_EQ (queue.Enqueue (MakeEntry (a, 100), dropped), true, "Packet not queued");
+  DlarpRequestQueue::Entry late = MakeEntry (c, 100);
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (late, dropped), false, "DROP_TAIL queued past the packet cap");
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 1, "DROP_TAIL did not drop the arriving packet");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].packet->GetUid (), late.packet->GetUid (), "DROP_TAIL dropped another packet");
+  queue.SetDropPolicy (DlarpRequestQueue::DROP_OLDEST);
+  dropped.clear ();
+  NS_TEST_EXPECT_MSG_EQ (queue.Enqueue (late, dropped), true, "DROP_OLDEST did not queue the arriving packet");
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 1, "DROP_OLDEST did not drop one packet");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].packet->GetUid (), first.packet->GetUid (), "DROP_OLDEST did not drop the oldest");
+  NS_TEST_EXPECT_MSG_EQ (queue.GetSize (), 3, "Wrong size at the packet cap");
+  NS_TEST_EXPECT_MSG_EQ (queue.Find (a), true, "The second packet of a destination was dropped with its first");
+  NS_TEST_EXPECT_MSG_EQ (queue.Find (c), true, "Arriving packet not found");
+
+  // Byte cap: as many packets dropped as needed to make room
+  DlarpRequestQueue bytes (10, 250, Seconds (10), DlarpRequestQueue::DROP_TAIL);
+  dropped.clear ();
+  first = MakeEntry (a, 100);
+  bytes.Enqueue (first, dropped);
+  bytes.Enqueue (MakeEntry (b, 100), dropped);
+  NS_TEST_EXPECT_MSG_EQ (bytes.Enqueue (MakeEntry (c, 100), dropped), false, "DROP_TAIL queued past the byte cap");
+  NS_TEST_EXPECT_MSG_EQ (bytes.GetBytes (), 200, "Wrong byte count");
+  bytes.SetDropPolicy (DlarpRequestQueue::DROP_OLDEST);
+  dropped.clear ();
+  NS_TEST_EXPECT_MSG_EQ (bytes.Enqueue (MakeEntry (c, 150), dropped), true, "DROP_OLDEST did not make room");
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 1, "DROP_OLDEST dropped more than needed");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].packet->GetUid (), first.packet->GetUid (), "DROP_OLDEST did not drop the oldest");
+  NS_TEST_EXPECT_MSG_EQ (bytes.GetBytes (), 250, "Wrong byte count");
+  dropped.clear ();
+  NS_TEST_EXPECT_MSG_EQ (bytes.Enqueue (MakeEntry (a, 300), dropped), false, "Packet larger than the cap queued");
+  NS_TEST_EXPECT_MSG_EQ (dropped.size (), 1, "Room made for a packet larger than the cap");
+  NS_TEST_EXPECT_MSG_EQ (bytes.GetSize (), 2, "Packets lost to a packet larger than the cap");
+
+  // Re-queued packets keep their earlier expiry, and go first both in the
+  // FIFO of their destination and in the drop order
+  DlarpRequestQueue requeue (4, 10000, Seconds (10), DlarpRequestQueue::DROP_OLDEST);
+  dropped.clear ();
+  DlarpRequestQueue::Entry a1 = MakeEntry (a, 100);
+  DlarpRequestQueue::Entry b1 = MakeEntry (b, 100);
+  DlarpRequestQueue::Entry a2 = MakeEntry (a, 100, Seconds (2));
+  DlarpRequestQueue::Entry b2 = MakeEntry (b, 100, Seconds (3));
+  requeue.Enqueue (a1, dropped);
+  requeue.Enqueue (b1, dropped);
+  requeue.Enqueue (a2, dropped);
+  requeue.Enqueue (b2, dropped);
+  requeue.Enqueue (MakeEntry (c, 100), dropped);
+  requeue.Enqueue (MakeEntry (c, 100), dropped);
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 2, "Wrong number of packets dropped");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].packet->GetUid (), a2.packet->GetUid (), "The earliest expiry was not dropped first");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].expire, Seconds (2), "Re-queued packet lost its expiry");
+  NS_TEST_EXPECT_MSG_EQ (dropped[1].packet->GetUid (), b2.packet->GetUid (), "The next expiry was not dropped next");
+  std::vector<uint64_t> uids = DequeueUids (requeue, a);
+  NS_TEST_EXPECT_MSG_EQ (uids.size () == 1 && uids[0] == a1.packet->GetUid (), true, "Wrong packets left for a");
+  requeue.Enqueue (a1, dropped);
+  requeue.Enqueue (a2, dropped);
+  uids = DequeueUids (requeue, a);
+  NS_TEST_EXPECT_MSG_EQ (uids.size () == 2 && uids[0] == a2.packet->GetUid () && uids[1] == a1.packet->GetUid (),
+                         true, "The FIFO of a destination is not in expiry order");
+
+  // An idle queue drops its expired packets when asked to, with their expiry
+  DlarpRequestQueue idle (4, 10000, Seconds (10), DlarpRequestQueue::DROP_TAIL);
+  dropped.clear ();
+  idle.Enqueue (MakeEntry (a, 100, Seconds (5)), dropped);
+  idle.Enqueue (MakeEntry (b, 100), dropped);
+  Simulator::Stop (Seconds (6));
+  Simulator::Run ();
+  idle.DropExpired (dropped);
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 1, "The expired packet was not dropped");
+  NS_TEST_EXPECT_MSG_EQ (dropped[0].expire <= Simulator::Now (), true, "A live packet was dropped");
+  NS_TEST_EXPECT_MSG_EQ (idle.Find (a), false, "Expired destination still queued");
+  NS_TEST_EXPECT_MSG_EQ (idle.Find (b), true, "Live destination lost");
+  Simulator::Destroy ();
+
+  // Destinations with the same home bucket, and one homed just after them,
+  // queued interleaved; erasing a FIFO must not lose those probed past it.
+  // The index of 8 packets has 16 buckets, found by Fibonacci hashing
+  std::vector<Ipv4Address> colliding;
+  Ipv4Address next;
+  uint32_t home = (Ipv4Address ("10.0.1.0").Get () * 2654435769u) >> 28;
+  for (uint32_t addr = Ipv4Address ("10.0.1.0").Get (); colliding.size () < 3 || next == Ipv4Address (); ++addr)
+    {
+      uint32_t bucket = (addr * 2654435769u) >> 28;
+      if (bucket == home && colliding.size () < 3)
+        {
+          colliding.push_back (Ipv4Address (addr));
+        }
+      else if (bucket == ((home + 1) & 15) && next == Ipv4Address ())
+        {
+          next = Ipv4Address (addr);
+        }
+    }
+  colliding.push_back (next);
+  DlarpRequestQueue index (8, 10000, Seconds (10), DlarpRequestQueue::DROP_TAIL);
+  dropped.clear ();
+  std::vector<std::vector<uint64_t> > queued (colliding.size ());
+  for (uint32_t round = 0; round < 2; ++round)
+    {
+      for (uint32_t i = 0; i < colliding.size (); ++i)
+        {
+          DlarpRequestQueue::Entry entry = MakeEntry (colliding[i], 100);
+          NS_TEST_ASSERT_MSG_EQ (index.Enqueue (entry, dropped), true, "Colliding packet not queued");
+          queued[i].push_back (entry.packet->GetUid ());
+        }
+    }
+  // The middle of the cluster first, then its head, then the rest
+  const uint32_t order[] = { 1, 0, 3, 2 };
+  for (uint32_t k = 0; k < 4; ++k)
+    {
+      uint32_t i = order[k];
+      NS_TEST_EXPECT_MSG_EQ (DequeueUids (index, colliding[i]) == queued[i], true, "Wrong FIFO of a colliding destination");
+      for (uint32_t l = k + 1; l < 4; ++l)
+        {
+          NS_TEST_EXPECT_MSG_EQ (index.Find (colliding[order[l]]), true, "Colliding destination lost by an erasure");
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (index.GetSize (), 0, "Queue not empty");
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief DLARP messages: serialization round trips and rejection of truncated messages
+ */
+class DlarpHeaderTest : public TestCase
+{
+public:
+  DlarpHeaderTest () : TestCase ("DLARP message serialization")
+  {
+  }
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Serialize a message, check that it reads back whole and that
+   * every shorter prefix of it is rejected
+   * \param header the message
+   * \return the message read back
+   */
+  DlarpHeader RoundTrip (const DlarpHeader &header);
+};
+
+DlarpHeader
+DlarpHeaderTest::RoundTrip (const DlarpHeader &header)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  uint32_t size = packet->GetSize ();
+  NS_TEST_EXPECT_MSG_EQ (size, header.GetSerializedSize (), "Wrong serialized size");
+
+  DlarpHeader read;
+  packet->RemoveHeader (read);
+  NS_TEST_EXPECT_MSG_EQ (read.IsValid (), true, "Message rejected");
+  NS_TEST_EXPECT_MSG_EQ (packet->GetSize (), 0, "Message not read whole");
+
+  std::vector<uint8_t> bytes (size);
+  Ptr<Packet> copy = Create<Packet> ();
+  copy->AddHeader (header);
+  copy->CopyData (bytes.data (), size);
+  for (uint32_t length = 1; length < size; ++length)
+    {
+      Ptr<Packet> truncated = Create<Packet> (bytes.data (), length);
+      DlarpHeader partial;
+      truncated->RemoveHeader (partial);
+      NS_TEST_EXPECT_MSG_EQ (partial.IsValid (), false, "Truncated message accepted");
+    }
+  return read;
+}
+
+void
+DlarpHeaderTest::DoRun (void)
+{
+  DlarpHeader rreq (DLARPTYPE_RREQ);
+  rreq.SetHopCount (2);
+  rreq.SetTtl (5);
+  rreq.SetMetric (3.25);
+  rreq.SetRequestId (7);
+  rreq.SetSrc (Ipv4Address ("10.0.0.1"));
+  rreq.SetSeqNo (42);
+  rreq.SetDst (Ipv4Address ("10.0.0.9"));
+  DlarpHeader read = RoundTrip (rreq);
+  NS_TEST_EXPECT_MSG_EQ (read.GetType (), DLARPTYPE_RREQ, "RREQ type");
+  NS_TEST_EXPECT_MSG_EQ (read.GetHopCount (), 2, "RREQ hop count");
+  NS_TEST_EXPECT_MSG_EQ (read.GetTtl (), 5, "RREQ TTL");
+  NS_TEST_EXPECT_MSG_EQ (read.GetMetric (), 3.25, "RREQ metric");
+  NS_TEST_EXPECT_MSG_EQ (read.GetRequestId (), 7, "RREQ request ID");
+  NS_TEST_EXPECT_MSG_EQ (read.GetSrc (), Ipv4Address ("10.0.0.1"), "RREQ source");
+  NS_TEST_EXPECT_MSG_EQ (read.GetSeqNo (), 42, "RREQ sequence number");
+  NS_TEST_EXPECT_MSG_EQ (read.GetDst (), Ipv4Address ("10.0.0.9"), "RREQ destination");
+
+  DlarpHeader rrep (DLARPTYPE_RREP);
+  rrep.SetHopCount (3);
+  rrep.SetMetric (5000);
+  rrep.SetSrc (Ipv4Address ("10.0.0.1"));
+  rrep.SetDst (Ipv4Address ("10.0.0.9"));
+  rrep.SetSeqNo (43);
+  read = RoundTrip (rrep);
+  NS_TEST_EXPECT_MSG_EQ (read.GetHopCount (), 3, "RREP hop count");
+  NS_TEST_EXPECT_MSG_EQ (read.GetMetric (), 4095.9375, "RREP metric not saturated");
+  NS_TEST_EXPECT_MSG_EQ (read.GetSrc (), Ipv4Address ("10.0.0.1"), "RREP source");
+  NS_TEST_EXPECT_MSG_EQ (read.GetDst (), Ipv4Address ("10.0.0.9"), "RREP destination");
+  NS_TEST_EXPECT_MSG_EQ (read.GetSeqNo (), 43, "RREP sequence number");
+
+  DlarpHeader rerr (DLARPTYPE_RERR);
+  rerr.SetSrc (Ipv4Address ("10.0.0.1"));
+  rerr.SetDst (Ipv4Address ("10.0.0.9"));
+  read = RoundTrip (rerr);
+  NS_TEST_EXPECT_MSG_EQ (read.GetSrc (), Ipv4Address ("10.0.0.1"), "RERR source");
+  NS_TEST_EXPECT_MSG_EQ (read.GetDst (), Ipv4Address ("10.0.0.9"), "RERR destination");
+
+  DlarpHeader hello (DLARPTYPE_HELLO);
+  hello.SetSeqNo (9);
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      DlarpHelloRecord record;
+      record.neighbor = Ipv4Address (0x0a000002 + i);
+      record.ratio = i / 2.0;
+      hello.AddHelloRecord (record);
+    }
+  read = RoundTrip (hello);
+  NS_TEST_EXPECT_MSG_EQ (read.GetSeqNo (), 9, "HELLO sequence number");
+  NS_TEST_ASSERT_MSG_EQ (read.GetNHelloRecords (), 3, "HELLO record count");
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (read.GetHelloRecord (i).neighbor, Ipv4Address (0x0a000002 + i), "HELLO neighbor");
+      NS_TEST_EXPECT_MSG_EQ_TOL (read.GetHelloRecord (i).ratio, i / 2.0, 1.0 / 255, "HELLO ratio");
+    }
+
+  DlarpHeader agreement (DLARPTYPE_AGREEMENT);
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      DlarpAgreementRecord record;
+      record.dst = Ipv4Address (0x0a000005 + i);
+      record.nextHop = Ipv4Address (0x0a000007 + i);
+      record.seqNo = 100 + i;
+      record.metric = 1.5 + i;
+      agreement.AddAgreementRecord (record);
+    }
+  read = RoundTrip (agreement);
+  NS_TEST_ASSERT_MSG_EQ (read.GetNAgreementRecords (), 2, "AGREEMENT record count");
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (read.GetAgreementRecord (i).dst, Ipv4Address (0x0a000005 + i), "AGREEMENT destination");
+      NS_TEST_EXPECT_MSG_EQ (read.GetAgreementRecord (i).nextHop, Ipv4Address (0x0a000007 + i), "AGREEMENT next hop");
+      NS_TEST_EXPECT_MSG_EQ (read.GetAgreementRecord (i).seqNo, 100 + i, "AGREEMENT sequence number");
+      NS_TEST_EXPECT_MSG_EQ (read.GetAgreementRecord (i).metric, 1.5 + i, "AGREEMENT metric");
+    }
+
+  DlarpHeader auth (DLARPTYPE_AUTH1);
+  auth.SetSeqNo (11);
+  NS_TEST_EXPECT_MSG_EQ (auth.GetSerializedSize (), DLARP_AUTH1_SIZE, "AUTH1 size");
+  read = RoundTrip (auth);
+  NS_TEST_EXPECT_MSG_EQ (read.GetSeqNo (), 11, "AUTH1 handshake ID");
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Two authenticating neighbors: the handshake completes over DLARP's
+ * own sockets and the data held for it is delivered
+ */
+class DlarpHandshakeTest : public TestCase
+{
+public:
+  DlarpHandshakeTest () : TestCase ("Two-node authenticated route"), m_received (0)
+  {
+  }
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Send a datagram
+   * \param socket the socket of the sender
+   * \param dst the receiver
+   */
+  void Send (Ptr<Socket> socket, Ipv4Address dst);
+  /**
+   * \brief Count the datagrams received
+   * \param socket the socket of the receiver
+   */
+  void Receive (Ptr<Socket> socket);
+
+  uint32_t m_received; //!< Datagrams received
+};
+
+void
+DlarpHandshakeTest::Send (Ptr<Socket> socket, Ipv4Address dst)
+{
+  socket->SendTo (Create<Packet> (100), 0, InetSocketAddress (dst, 9));
+}
+
+void
+DlarpHandshakeTest::Receive (Ptr<Socket> socket)
+{
+  Address from;
+  while (socket->RecvFrom (from))
+    {
+      m_received++;
+    }
+}
+
+void
+DlarpHandshakeTest::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+
+  DlarpHelper dlarp;
+  dlarp.Set ("Authentication", BooleanValue (true));
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (dlarp);
+  internet.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  TypeId udp = TypeId::LookupByName ("ns3::UdpSocketFactory");
+  Ptr<Socket> sink = Socket::CreateSocket (nodes.Get (1), udp);
+  sink->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  sink->SetRecvCallback (MakeCallback (&DlarpHandshakeTest::Receive, this));
+  Ptr<Socket> source = Socket::CreateSocket (nodes.Get (0), udp);
+  // The first datagrams wait in the send buffer for the handshake
+  const uint32_t count = 5;
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      Simulator::Schedule (Seconds (3) + MilliSeconds (10 * i), &DlarpHandshakeTest::Send, this,
+                           source, interfaces.GetAddress (1));
+    }
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  DlarpStats stats = dlarp.GetStats (nodes);
+  NS_TEST_EXPECT_MSG_EQ (stats.handshakesSucceeded, 2, "Both neighbors did not establish the session");
+  NS_TEST_EXPECT_MSG_EQ (stats.handshakesFailed, 0, "A handshake failed");
+  NS_TEST_EXPECT_MSG_EQ (m_received, count, "The datagrams held for the handshake were not delivered");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Split horizon: an AGREEMENT record that routes back through its
+ * receiver removes the receiver's route through the sender
+ *
+ * Node A runs no DLARP: it sends hand-made AGREEMENT messages to the DLARP
+ * port of node B.
+ */
+class DlarpSplitHorizonTest : public TestCase
+{
+public:
+  DlarpSplitHorizonTest () : TestCase ("Poisoned AGREEMENT records")
+  {
+  }
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Send an AGREEMENT with one record
+   * \param socket the socket of node A
+   * \param to the DLARP socket of node B
+   * \param record the record
+   */
+  void SendAgreement (Ptr<Socket> socket, InetSocketAddress to, DlarpAgreementRecord record);
+};
+
+void
+DlarpSplitHorizonTest::SendAgreement (Ptr<Socket> socket, InetSocketAddress to, DlarpAgreementRecord record)
+{
+  DlarpHeader agreement (DLARPTYPE_AGREEMENT);
+  agreement.AddAgreementRecord (record);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (agreement);
+  socket->SendTo (packet, 0, to);
+}
+
+void
+DlarpSplitHorizonTest::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+  InternetStackHelper plain;
+  plain.Install (nodes.Get (0));
+  DlarpHelper dlarp;
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (dlarp);
+  internet.Install (nodes.Get (1));
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+  Ipv4Address a = interfaces.GetAddress (0);
+  Ipv4Address b = interfaces.GetAddress (1);
+  Ptr<DlarpRoutingProtocol> routing =
+    DynamicCast<DlarpRoutingProtocol> (nodes.Get (1)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+  NS_TEST_ASSERT_MSG_EQ (routing != 0, true, "DLARP is not the routing protocol of node B");
+
+  Ptr<Socket> socket = Socket::CreateSocket (nodes.Get (0), TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  InetSocketAddress to (b, DlarpRoutingProtocol::DLARP_PORT);
+  DlarpAgreementRecord record;
+  record.dst = Ipv4Address ("10.1.1.99");
+  record.nextHop = Ipv4Address ("10.1.1.50");
+  record.seqNo = 5;
+  record.metric = 1;
+  // A routes to the destination through another node: B learns a route through A
+  Simulator::Schedule (Seconds (1), &DlarpSplitHorizonTest::SendAgreement, this, socket, to, record);
+  Simulator::Stop (Seconds (1.5));
+  Simulator::Run ();
+  DlarpRoutingTableEntry *entry = routing->GetRoutingTable ().LookupRoute (record.dst);
+  NS_TEST_ASSERT_MSG_EQ (entry != 0, true, "Route through A not installed");
+  NS_TEST_EXPECT_MSG_EQ (entry->GetNextHop (), a, "Route not through A");
+
+  // A now routes to it through B: the route through A would loop
+  record.nextHop = b;
+  Simulator::Schedule (Seconds (0.5), &DlarpSplitHorizonTest::SendAgreement, this, socket, to, record);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->GetRoutingTable ().LookupRoute (record.dst) == 0, true,
+                         "Route through A kept after a poisoned record");
+
+  // A fresher poisoned record does not install a route either
+  record.seqNo = 6;
+  Simulator::Schedule (Seconds (0.5), &DlarpSplitHorizonTest::SendAgreement, this, socket, to, record);
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (routing->GetRoutingTable ().LookupRoute (record.dst) == 0, true,
+                         "Route installed from a poisoned record");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief Drops the first datagram that carries an M3 of the handshake
+ */
+class DlarpDropAuth3ErrorModel : public ErrorModel
+{
+public:
+  DlarpDropAuth3ErrorModel () : m_dropped (false)
+  {
+  }
+
+private:
+  virtual bool DoCorrupt (Ptr<Packet> p);
+  virtual void DoReset (void);
+
+  bool m_dropped; //!< An M3 was dropped
+};
+
+bool
+DlarpDropAuth3ErrorModel::DoCorrupt (Ptr<Packet> p)
+{
+  if (m_dropped)
+    {
+      return false;
+    }
+  Ptr<Packet> copy = p->Copy ();
+  Ipv4Header ipv4;
+  copy->RemoveHeader (ipv4);
+  if (ipv4.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+      return false;
+    }
+  UdpHeader udp;
+  copy->RemoveHeader (udp);
+  if (udp.GetDestinationPort () != DlarpRoutingProtocol::DLARP_PORT)
+    {
+      return false;
+    }
+  while (copy->GetSize () > 0)
+    {
+      DlarpHeader header;
+      copy->RemoveHeader (header);
+      if (!header.IsValid ())
+        {
+          return false;
+        }
+      if (header.GetType () == DLARPTYPE_AUTH3)
+        {
+          m_dropped = true;
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+DlarpDropAuth3ErrorModel::DoReset (void)
+{
+  m_dropped = false;
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief A lost M3: the responder forgets the half-open handshake without
+ * distrusting the initiator, and later starts its own
+ */
+class DlarpLostAuth3Test : public TestCase
+{
+public:
+  DlarpLostAuth3Test () : TestCase ("Authenticated routes after a lost M3"), m_firstNode (0)
+  {
+    m_received[0] = 0;
+    m_received[1] = 0;
+  }
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Send a datagram
+   * \param socket the socket of the sender
+   * \param dst the receiver
+   */
+  void Send (Ptr<Socket> socket, Ipv4Address dst);
+  /**
+   * \brief Count the datagrams received, by node
+   * \param socket the socket of the receiver
+   */
+  void Receive (Ptr<Socket> socket);
+
+  uint32_t m_firstNode;   //!< ID of node 0
+  uint32_t m_received[2]; //!< Datagrams received by each node
+};
+
+void
+DlarpLostAuth3Test::Send (Ptr<Socket> socket, Ipv4Address dst)
+{
+  socket->SendTo (Create<Packet> (100), 0, InetSocketAddress (dst, 9));
+}
+
+void
+DlarpLostAuth3Test::Receive (Ptr<Socket> socket)
+{
+  Address from;
+  while (socket->RecvFrom (from))
+    {
+      m_received[socket->GetNode ()->GetId () - m_firstNode]++;
+    }
+}
+
+void
+DlarpLostAuth3Test::DoRun (void)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  m_firstNode = nodes.Get (0)->GetId ();
+  SimpleNetDeviceHelper simple;
+  NetDeviceContainer devices = simple.Install (nodes);
+  // The M3 of the handshake started by node 0 never reaches node 1
+  DynamicCast<SimpleNetDevice> (devices.Get (1))->SetReceiveErrorModel (CreateObject<DlarpDropAuth3ErrorModel> ());
+
+  DlarpHelper dlarp;
+  dlarp.Set ("Authentication", BooleanValue (true));
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (dlarp);
+  internet.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  TypeId udp = TypeId::LookupByName ("ns3::UdpSocketFactory");
+  Ptr<Socket> sockets[2];
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      sockets[i] = Socket::CreateSocket (nodes.Get (i), udp);
+      sockets[i]->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+      sockets[i]->SetRecvCallback (MakeCallback (&DlarpLostAuth3Test::Receive, this));
+    }
+  // Node 0 starts the handshake and trusts node 1 once it has sent M3;
+  // node 1 times out waiting for it, and starts its own handshake for the
+  // datagrams it sends back
+  const uint32_t count = 5;
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      Simulator::Schedule (Seconds (3) + MilliSeconds (10 * i), &DlarpLostAuth3Test::Send, this,
+                           sockets[0], interfaces.GetAddress (1));
+      Simulator::Schedule (Seconds (6) + MilliSeconds (10 * i), &DlarpLostAuth3Test::Send, this,
+                           sockets[1], interfaces.GetAddress (0));
+    }
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  DlarpStats stats = dlarp.GetStats (nodes);
+  NS_TEST_EXPECT_MSG_EQ (stats.handshakesFailed, 0, "The lost M3 failed a handshake");
+  NS_TEST_EXPECT_MSG_EQ (stats.handshakesSucceeded, 3, "Node 1 did not establish a session of its own");
+  NS_TEST_EXPECT_MSG_EQ (m_received[1], count, "Node 0 did not trust node 1 after sending M3");
+  NS_TEST_EXPECT_MSG_EQ (m_received[0], count, "Node 1 did not reach node 0 after the lost M3");
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dlarp-test
+ * \brief DLARP test suite
+ */
+class DlarpTestSuite : public TestSuite
+{
+public:
+  DlarpTestSuite () : TestSuite ("routing-dlarp", UNIT)
+  {
+    AddTestCase (new DlarpRoutingTableTest, TestCase::QUICK);
+    AddTestCase (new DlarpFlowHashTest, TestCase::QUICK);
+    AddTestCase (new DlarpTimerWheelTest, TestCase::QUICK);
+    AddTestCase (new DlarpRequestQueueTest, TestCase::QUICK);
+    AddTestCase (new DlarpHeaderTest, TestCase::QUICK);
+    AddTestCase (new DlarpSplitHorizonTest, TestCase::QUICK);
+    AddTestCase (new DlarpHandshakeTest, TestCase::QUICK);
+    AddTestCase (new DlarpLostAuth3Test, TestCase::QUICK);
+  }
+};
+
+static DlarpTestSuite g_dlarpTestSuite; //!< Static variable for test initialization
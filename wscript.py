@@ -4,13 +4,38 @@ def build(bld):
     module = bld.create_ns3_module('dlarp', ['internet', 'wifi'])
     module.source = [
         'model/dlarp.cc',
+        'model/dlarp-rtable.cc',
+        'model/dlarp-packet.cc',
+        'model/dlarp-id-cache.cc',
+        'model/dlarp-timer-wheel.cc',
+        'model/dlarp-link-estimator.cc',
+        'model/dlarp-rqueue.cc',
+        'model/dlarp-stats.cc',
+        'model/dlarp-snapshot.cc',
+        'model/dlarp-session-cache.cc',
+        'model/dlarp-key-table.cc',
         'helper/dlarp-helper.cc',
         ]
 
+    module_test = bld.create_ns3_module_test_library('dlarp')
+    module_test.source = [
+        'test/dlarp-test-suite.cc',
+        ]
+
     headers = bld(features='ns3header')
     headers.module = 'dlarp'
     headers.source = [
         'model/dlarp.h',
+        'model/dlarp-rtable.h',
+        'model/dlarp-packet.h',
+        'model/dlarp-id-cache.h',
+        'model/dlarp-timer-wheel.h',
+        'model/dlarp-link-estimator.h',
+        'model/dlarp-rqueue.h',
+        'model/dlarp-stats.h',
+        'model/dlarp-snapshot.h',
+        'model/dlarp-session-cache.h',
+        'model/dlarp-key-table.h',
         'helper/dlarp-helper.h',
         ]
 